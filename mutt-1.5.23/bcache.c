@@ -22,23 +22,69 @@
 #endif                                            /* HAVE_CONFIG_H */
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <utime.h>
 
 #include "mutt.h"
 #include "account.h"
 #include "url.h"
+#include "hash.h"
 #include "bcache.h"
 
 #include "lib.h"
 
+/*
+ * Each cache directory carries an index file listing the cached ids
+ * with their size and last access time.  It is read when the cache
+ * is opened and rewritten when it is closed, so that existence checks
+ * and listings do not touch every file, and so that the cache can be
+ * kept below $message_cache_size by evicting the least recently used
+ * entries.  The limit applies to each directory, i.e. to each mailbox,
+ * on its own.  If the directory was changed after the index was
+ * written (a crash, or the user removing entries by hand), the index
+ * is rebuilt from the directory.  If another mutt rewrote the index
+ * while the cache was open, the directory is read again before the
+ * index is rewritten, so that neither loses the other's entries.
+ *
+ * Messages are downloaded to "<id>.tmp" and renamed on commit.  Such
+ * files are never indexed: the ones left by a failed download are
+ * removed when the cache is closed, and the ones left by a crash are
+ * removed by the rebuild, since creating them made the directory newer
+ * than the index.
+ */
+#define BCACHE_INDEX ".index"
+#define BCACHE_INDEX_MAGIC "mutt-bcache 1"
+
+struct bcache_entry
+{
+        char *id;
+        long size;
+        time_t atime;
+        unsigned int seen : 1;                    /* found by bcache_scan() */
+        struct bcache_entry *prev, *next;
+};
+
 struct body_cache
 {
         char path[_POSIX_PATH_MAX];
         size_t pathlen;
+        HASH *index;                              /* id -> struct bcache_entry */
+        struct bcache_entry *entries;
+        unsigned int count;
+        LOFF_T total;                             /* bytes in the cache */
+        LIST *pending;                            /* ids put as tmp, not committed */
+        ino_t index_ino;                          /* the index file as last read or written */
+        time_t index_mtime;
+        unsigned int dirty : 1;
 };
 
+static void bcache_evict (body_cache_t *bcache, const char *keep);
+
 static int bcache_path(ACCOUNT *account, const char *mailbox,
 char *dst, size_t dstlen)
 {
@@ -80,6 +126,259 @@ char *dst, size_t dstlen)
 }
 
 
+static struct bcache_entry *bcache_find (body_cache_t *bcache, const char *id)
+{
+        return bcache->index ? hash_find (bcache->index, id) : NULL;
+}
+
+
+static struct bcache_entry *bcache_add (body_cache_t *bcache, const char *id,
+long size, time_t atime)
+{
+        struct bcache_entry *e;
+
+        if ((e = bcache_find (bcache, id))) {
+                bcache->total += size - e->size;
+                e->size = size;
+                e->atime = atime;
+                return e;
+        }
+
+        e = safe_calloc (1, sizeof (struct bcache_entry));
+        e->id = safe_strdup (id);
+        e->size = size;
+        e->atime = atime;
+        if ((e->next = bcache->entries))
+                e->next->prev = e;
+        bcache->entries = e;
+        hash_insert (bcache->index, e->id, e, 0);
+        bcache->count++;
+        bcache->total += size;
+        return e;
+}
+
+
+static void bcache_remove (body_cache_t *bcache, struct bcache_entry *e)
+{
+        hash_delete (bcache->index, e->id, e, NULL);
+        if (e->prev)
+                e->prev->next = e->next;
+        else
+                bcache->entries = e->next;
+        if (e->next)
+                e->next->prev = e->prev;
+        bcache->count--;
+        bcache->total -= e->size;
+        FREE (&e->id);
+        FREE (&e);
+}
+
+
+/* read the directory itself, for a missing or outdated index.  Entries
+ * already known keep the later of the two access times; those whose
+ * file is gone are dropped. */
+static void bcache_scan (body_cache_t *bcache)
+{
+        char path[_POSIX_PATH_MAX];
+        struct bcache_entry *e, *next;
+        struct dirent *de;
+        struct stat st;
+        time_t atime;
+        size_t n;
+        DIR *d;
+
+        if (!(d = opendir (bcache->path)))
+                return;
+
+        dprint (2, (debugfile, "bcache: rebuilding index for '%s'\n", bcache->path));
+
+        while ((de = readdir (d))) {
+                if (de->d_name[0] == '.')
+                        continue;
+                if (snprintf (path, sizeof (path), "%s%s", bcache->path, de->d_name) >= sizeof (path))
+                        continue;
+                if ((n = mutt_strlen (de->d_name)) > 4 && !strcmp (de->d_name + n - 4, ".tmp")) {
+                        dprint (2, (debugfile, "bcache: removing stale '%s'\n", path));
+                        unlink (path);
+                        continue;
+                }
+                if (stat (path, &st) == 0 && S_ISREG (st.st_mode) && st.st_size) {
+                        atime = st.st_atime;
+                        if ((e = bcache_find (bcache, de->d_name)) && e->atime > atime)
+                                atime = e->atime;
+                        bcache_add (bcache, de->d_name, st.st_size, atime)->seen = 1;
+                }
+        }
+        closedir (d);
+
+        for (e = bcache->entries; e; e = next) {
+                next = e->next;
+                if (e->seen)
+                        e->seen = 0;
+                else
+                        bcache_remove (bcache, e);
+        }
+        bcache->dirty = 1;
+}
+
+
+/* has the index been rewritten since it was last read or written here? */
+static int bcache_index_changed (body_cache_t *bcache, const char *path)
+{
+        struct stat st;
+
+        if (stat (path, &st) < 0)
+                return 0;
+        return st.st_ino != bcache->index_ino || st.st_mtime != bcache->index_mtime;
+}
+
+
+static void bcache_index_stamp (body_cache_t *bcache, const char *path)
+{
+        struct stat st;
+
+        if (stat (path, &st) == 0) {
+                bcache->index_ino = st.st_ino;
+                bcache->index_mtime = st.st_mtime;
+        }
+}
+
+
+static void bcache_read_index (body_cache_t *bcache)
+{
+        char path[_POSIX_PATH_MAX];
+        char buf[LONG_STRING];
+        struct stat dst, ist;
+        FILE *fp = NULL;
+        long size, atime;
+        int n;
+
+        bcache->index = hash_create (1031, 0);
+
+        if (stat (bcache->path, &dst) < 0)
+                return;                           /* nothing cached yet */
+
+        if (snprintf (path, sizeof (path), "%s%s", bcache->path, BCACHE_INDEX) >= sizeof (path) ||
+                stat (path, &ist) < 0)
+                ist.st_mtime = 0;
+        else {
+                bcache->index_ino = ist.st_ino;
+                bcache->index_mtime = ist.st_mtime;
+        }
+
+        if (!ist.st_mtime || dst.st_mtime > ist.st_mtime ||
+                !(fp = fopen (path, "r")) ||
+                !fgets (buf, sizeof (buf), fp) ||
+                mutt_strncmp (buf, BCACHE_INDEX_MAGIC "\n", sizeof (BCACHE_INDEX_MAGIC))) {
+                safe_fclose (&fp);
+                bcache_scan (bcache);
+                return;
+        }
+
+        while (fgets (buf, sizeof (buf), fp)) {
+                mutt_remove_trailing_ws (buf);
+                if (sscanf (buf, "%ld %ld %n", &atime, &size, &n) == 2 && buf[n])
+                        bcache_add (bcache, buf + n, size, (time_t) atime);
+        }
+        safe_fclose (&fp);
+}
+
+
+static void bcache_write_index (body_cache_t *bcache)
+{
+        char path[_POSIX_PATH_MAX];
+        char tmp[_POSIX_PATH_MAX];
+        struct bcache_entry *e;
+        FILE *fp;
+
+        if (snprintf (path, sizeof (path), "%s%s", bcache->path, BCACHE_INDEX) >= sizeof (path) ||
+                snprintf (tmp, sizeof (tmp), "%s.tmp", path) >= sizeof (tmp))
+                return;
+
+/* another mutt has the cache open too: take in its changes */
+        if (bcache_index_changed (bcache, path)) {
+                bcache_scan (bcache);
+                bcache_evict (bcache, NULL);
+        }
+
+        if (!(fp = fopen (tmp, "w"))) {
+                dprint (1, (debugfile, "bcache: can't write '%s': %s\n", tmp, strerror (errno)));
+                return;
+        }
+        fputs (BCACHE_INDEX_MAGIC "\n", fp);
+        for (e = bcache->entries; e; e = e->next)
+                fprintf (fp, "%ld %ld %s\n", (long) e->atime, e->size, e->id);
+
+        if (safe_fclose (&fp) != 0 || rename (tmp, path) < 0) {
+                unlink (tmp);
+                return;
+        }
+/* the rename touched the directory: keep the index at least as new */
+        utime (path, NULL);
+        bcache_index_stamp (bcache, path);
+        bcache->dirty = 0;
+}
+
+
+static int bcache_atime_cmp (const void *a, const void *b)
+{
+        const struct bcache_entry *ea = *(struct bcache_entry * const *) a;
+        const struct bcache_entry *eb = *(struct bcache_entry * const *) b;
+
+        return (ea->atime > eb->atime) - (ea->atime < eb->atime);
+}
+
+
+/*
+ * Remove least recently used entries until the cache is below
+ * $message_cache_size.  To avoid doing this on every put, we trim to
+ * nine tenths of the limit.  'keep' is never removed.
+ */
+static void bcache_evict (body_cache_t *bcache, const char *keep)
+{
+        char path[_POSIX_PATH_MAX];
+        struct bcache_entry **lru, *e;
+        LOFF_T limit = (LOFF_T) MessageCacheSize * 1024 * 1024;
+        unsigned int i, n;
+
+        if (MessageCacheSize <= 0 || bcache->total <= limit)
+                return;
+
+        lru = safe_malloc (bcache->count * sizeof (struct bcache_entry *));
+        for (n = 0, e = bcache->entries; e; e = e->next)
+                lru[n++] = e;
+        qsort (lru, n, sizeof (struct bcache_entry *), bcache_atime_cmp);
+
+        for (i = 0; i < n && bcache->total > limit / 10 * 9; i++) {
+                if (keep && !strcmp (lru[i]->id, keep))
+                        continue;
+                if (snprintf (path, sizeof (path), "%s%s", bcache->path, lru[i]->id) < sizeof (path)) {
+                        dprint (3, (debugfile, "bcache: evict: '%s'\n", path));
+                        unlink (path);
+                }
+                bcache_remove (bcache, lru[i]);
+        }
+        FREE (&lru);
+        bcache->dirty = 1;
+}
+
+
+/* forget a pending tmp download */
+static int bcache_unpend (body_cache_t *bcache, const char *id)
+{
+        LIST **p, *l;
+
+        for (p = &bcache->pending; (l = *p); p = &l->next)
+                if (!mutt_strcmp (l->data, id)) {
+                        *p = l->next;
+                        l->next = NULL;
+                        mutt_free_list (&l);
+                        return 0;
+                }
+        return -1;
+}
+
+
 body_cache_t *mutt_bcache_open (ACCOUNT *account, const char *mailbox)
 {
         struct body_cache *bcache = NULL;
@@ -92,6 +391,8 @@ body_cache_t *mutt_bcache_open (ACCOUNT *account, const char *mailbox)
                 sizeof (bcache->path)) < 0)
                 goto bail;
         bcache->pathlen = mutt_strlen (bcache->path);
+        bcache_read_index (bcache);
+        bcache_evict (bcache, NULL);
 
         return bcache;
 
@@ -104,8 +405,27 @@ body_cache_t *mutt_bcache_open (ACCOUNT *account, const char *mailbox)
 
 void mutt_bcache_close (body_cache_t **bcache)
 {
+        char path[_POSIX_PATH_MAX];
+        struct bcache_entry *e, *next;
+        LIST *l;
+
         if (!bcache || !*bcache)
                 return;
+
+/* downloads that were never committed */
+        for (l = (*bcache)->pending; l; l = l->next)
+                if (snprintf (path, sizeof (path), "%s%s.tmp", (*bcache)->path, l->data) < sizeof (path))
+                        unlink (path);
+        mutt_free_list (&(*bcache)->pending);
+
+        if ((*bcache)->dirty)
+                bcache_write_index (*bcache);
+        for (e = (*bcache)->entries; e; e = next) {
+                next = e->next;
+                FREE (&e->id);
+                FREE (&e);
+        }
+        hash_destroy (&(*bcache)->index, NULL);
         FREE(bcache);                             /* __FREE_CHECKED__ */
 }
 
@@ -113,6 +433,7 @@ void mutt_bcache_close (body_cache_t **bcache)
 FILE* mutt_bcache_get(body_cache_t *bcache, const char *id)
 {
         char path[_POSIX_PATH_MAX];
+        struct bcache_entry *e;
         FILE* fp = NULL;
 
         if (!id || !*id || !bcache)
@@ -124,6 +445,14 @@ FILE* mutt_bcache_get(body_cache_t *bcache, const char *id)
 
         fp = safe_fopen (path, "r");
 
+        if ((e = bcache_find (bcache, id))) {
+                if (fp)
+                        e->atime = time (NULL);
+                else
+                        bcache_remove (bcache, e);
+                bcache->dirty = 1;
+        }
+
         dprint (3, (debugfile, "bcache: get: '%s': %s\n", path, fp == NULL ? "no" : "yes"));
 
         return fp;
@@ -140,8 +469,9 @@ FILE* mutt_bcache_put(body_cache_t *bcache, const char *id, int tmp)
         if (!id || !*id || !bcache)
                 return NULL;
 
-        snprintf (path, sizeof (path), "%s%s%s", bcache->path, id,
-                tmp ? ".tmp" : "");
+        if (snprintf (path, sizeof (path), "%s%s%s", bcache->path, id,
+                tmp ? ".tmp" : "") >= sizeof (path))
+                return NULL;
 
         if ((fp = safe_fopen (path, "w+")))
                 goto out;
@@ -161,6 +491,10 @@ FILE* mutt_bcache_put(body_cache_t *bcache, const char *id, int tmp)
         }
 
         out:
+        if (fp && tmp) {
+                bcache_unpend (bcache, id);
+                bcache->pending = mutt_add_list (bcache->pending, id);
+        }
         dprint (3, (debugfile, "bcache: put: '%s'\n", path));
 
         return fp;
@@ -170,10 +504,25 @@ FILE* mutt_bcache_put(body_cache_t *bcache, const char *id, int tmp)
 int mutt_bcache_commit(body_cache_t* bcache, const char* id)
 {
         char tmpid[_POSIX_PATH_MAX];
+        char path[_POSIX_PATH_MAX];
+        struct stat st;
+
+        if (!bcache || !id || !*id)
+                return -1;
 
         snprintf (tmpid, sizeof (tmpid), "%s.tmp", id);
 
-        return mutt_bcache_move (bcache, tmpid, id);
+        if (mutt_bcache_move (bcache, tmpid, id) < 0)
+                return -1;
+        bcache_unpend (bcache, id);
+
+        snprintf (path, sizeof (path), "%s%s", bcache->path, id);
+        if (stat (path, &st) == 0) {
+                bcache_add (bcache, id, st.st_size, time (NULL));
+                bcache->dirty = 1;
+                bcache_evict (bcache, id);
+        }
+        return 0;
 }
 
 
@@ -181,6 +530,9 @@ int mutt_bcache_move(body_cache_t* bcache, const char* id, const char* newid)
 {
         char path[_POSIX_PATH_MAX];
         char newpath[_POSIX_PATH_MAX];
+        struct bcache_entry *e;
+        time_t atime;
+        long size;
 
         if (!bcache || !id || !*id || !newid || !*newid)
                 return -1;
@@ -190,13 +542,24 @@ int mutt_bcache_move(body_cache_t* bcache, const char* id, const char* newid)
 
         dprint (3, (debugfile, "bcache: mv: '%s' '%s'\n", path, newpath));
 
-        return rename (path, newpath);
+        if (rename (path, newpath) < 0)
+                return -1;
+
+        if ((e = bcache_find (bcache, id))) {
+                size = e->size;
+                atime = e->atime;
+                bcache_remove (bcache, e);
+                bcache_add (bcache, newid, size, atime);
+                bcache->dirty = 1;
+        }
+        return 0;
 }
 
 
 int mutt_bcache_del(body_cache_t *bcache, const char *id)
 {
         char path[_POSIX_PATH_MAX];
+        struct bcache_entry *e;
 
         if (!id || !*id || !bcache)
                 return -1;
@@ -207,6 +570,11 @@ int mutt_bcache_del(body_cache_t *bcache, const char *id)
 
         dprint (3, (debugfile, "bcache: del: '%s'\n", path));
 
+        if ((e = bcache_find (bcache, id))) {
+                bcache_remove (bcache, e);
+                bcache->dirty = 1;
+        }
+
         return unlink (path);
 }
 
@@ -214,12 +582,17 @@ int mutt_bcache_del(body_cache_t *bcache, const char *id)
 int mutt_bcache_exists(body_cache_t *bcache, const char *id)
 {
         char path[_POSIX_PATH_MAX];
+        struct bcache_entry *e;
         struct stat st;
         int rc = 0;
 
         if (!id || !*id || !bcache)
                 return -1;
 
+/* trust the index for known entries, only look for unknown ones */
+        if ((e = bcache_find (bcache, id)) && e->size)
+                return 0;
+
         path[0] = '\0';
         safe_strncat (path, sizeof (path), bcache->path, bcache->pathlen);
         safe_strncat (path, sizeof (path), id, mutt_strlen (id));
@@ -229,6 +602,11 @@ int mutt_bcache_exists(body_cache_t *bcache, const char *id)
         else
                 rc = S_ISREG(st.st_mode) && st.st_size != 0 ? 0 : -1;
 
+        if (rc == 0) {
+                bcache_add (bcache, id, st.st_size, st.st_atime);
+                bcache->dirty = 1;
+        }
+
         dprint (3, (debugfile, "bcache: exists: '%s': %s\n", path, rc == 0 ? "yes" : "no"));
 
         return rc;
@@ -239,35 +617,34 @@ int mutt_bcache_list(body_cache_t *bcache,
 int (*want_id)(const char *id, body_cache_t *bcache,
 void *data), void *data)
 {
-        DIR *d = NULL;
-        struct dirent *de;
-        int rc = -1;
-
-        if (!bcache || !(d = opendir (bcache->path)))
-                goto out;
+        struct bcache_entry *e;
+        char **ids;
+        unsigned int i, n;
+        int rc = 0;
 
-        rc = 0;
+        if (!bcache)
+                return -1;
 
         dprint (3, (debugfile, "bcache: list: dir: '%s'\n", bcache->path));
 
-        while ((de = readdir (d))) {
-                if (mutt_strncmp (de->d_name, ".", 1) == 0 ||
-                        mutt_strncmp (de->d_name, "..", 2) == 0)
-                        continue;
+/* the callback may delete entries, so walk a copy of the ids */
+        ids = safe_malloc ((bcache->count + 1) * sizeof (char *));
+        for (n = 0, e = bcache->entries; e; e = e->next)
+                ids[n++] = safe_strdup (e->id);
 
-                dprint (3, (debugfile, "bcache: list: dir: '%s', id :'%s'\n", bcache->path, de->d_name));
+        for (i = 0; i < n; i++) {
+                dprint (3, (debugfile, "bcache: list: dir: '%s', id :'%s'\n", bcache->path, ids[i]));
 
-                if (want_id && want_id (de->d_name, bcache, data) != 0)
-                        goto out;
+                if (want_id && want_id (ids[i], bcache, data) != 0)
+                        break;
 
                 rc++;
         }
 
-        out:
-        if (d) {
-                if (closedir (d) < 0)
-                        rc = -1;
-        }
+        for (i = 0; i < n; i++)
+                FREE (&ids[i]);
+        FREE (&ids);
+
         dprint (3, (debugfile, "bcache: list: did %d entries\n", rc));
         return rc;
 }
@@ -254,6 +254,8 @@ static BUFFY *buffy_new (const char *path)
 
 static void buffy_free (BUFFY **mailbox)
 {
+        FREE (&(*mailbox)->sb_name);
+        FREE (&(*mailbox)->sb_entry);
         FREE (mailbox);                           /* __FREE_CHECKED__ */
 }
 
@@ -34,6 +34,12 @@ typedef struct buffy_t
         short magic;                              /* mailbox type */
         short newly_created;                      /* mbox or mmdf just popped into existence */
         time_t last_visited;                      /* time of last exit from this mailbox */
+        char *sb_name;                            /* name shown in the sidebar */
+        char *sb_entry;                           /* sidebar line as last formatted */
+        unsigned int sb_serial;                   /* sidebar layout it was formatted for */
+        int sb_msgcount;                          /* counts it was formatted with */
+        int sb_unread;
+        int sb_flagged;
 }
 
 
@@ -346,6 +346,67 @@ int iconv_close (iconv_t cd)
 #endif /* !HAVE_ICONV */
 
 
+/*
+ * Descriptors handed out by mutt_iconv_open() are kept in a small
+ * cache keyed on the caller's (tocode, fromcode, flags), so that the
+ * charset canonicalisation, the hook lookups and iconv_open() itself
+ * only happen once per conversion.  A descriptor is in use between
+ * mutt_iconv_open() and mutt_iconv_close(); the latter resets its
+ * shift state and makes it available again.  Failed opens are cached
+ * too.  The cache depends on charset-hooks and iconv-hooks, and hook.c
+ * flushes it whenever those change.
+ */
+
+#define ICONV_CACHE_SIZE 16
+
+struct iconv_cache_t
+{
+  char *tocode;
+  char *fromcode;
+  int flags;
+  iconv_t cd;
+  unsigned long used;		/* LRU stamp, 0 for an empty slot */
+  unsigned int busy : 1;
+  unsigned int ascii : 1;	/* both sides are supersets of us-ascii */
+  unsigned int utf8 : 1;	/* utf-8 to utf-8 */
+};
+
+static struct iconv_cache_t IconvCache[ICONV_CACHE_SIZE];
+static unsigned long IconvCacheStamp = 0;
+
+/* charsets which represent 7-bit input as plain us-ascii */
+static int charset_is_ascii_superset (const char *chs)
+{
+  static const char *prefixes[] = {
+    "us-ascii", "utf-8", "iso-8859-", "windows-125", "koi8-", "euc-",
+    "gb", "big5", NULL
+  };
+  int i;
+
+  for (i = 0; prefixes[i]; i++)
+    if (!ascii_strncasecmp (chs, prefixes[i], strlen (prefixes[i])))
+      return 1;
+  return 0;
+}
+
+static void iconv_cache_clear (struct iconv_cache_t *c)
+{
+  if (c->used && !c->busy && c->cd != (iconv_t)(-1))
+    iconv_close (c->cd);
+  FREE (&c->tocode);
+  FREE (&c->fromcode);
+  memset (c, 0, sizeof (*c));
+}
+
+void mutt_iconv_cache_flush (void)
+{
+  int i;
+
+  for (i = 0; i < ICONV_CACHE_SIZE; i++)
+    if (IconvCache[i].used)
+      iconv_cache_clear (&IconvCache[i]);
+}
+
 /*
  * Like iconv_open, but canonicalises the charsets, applies
  * charset-hooks, recanonicalises, and finally applies iconv-hooks.
@@ -358,6 +419,8 @@ int iconv_close (iconv_t cd)
  * in some setups. Note: By design charset-hooks should never be, and
  * are never, applied to tocode. Highlight note: The top-well-named
  * M_ICONV_HOOK_FROM acts on charset-hooks, not at all on iconv-hooks.
+ *
+ * The descriptor must be released with mutt_iconv_close().
  */
 
 iconv_t mutt_iconv_open (const char *tocode, const char *fromcode, int flags)
@@ -366,9 +429,32 @@ iconv_t mutt_iconv_open (const char *tocode, const char *fromcode, int flags)
   char fromcode1[SHORT_STRING];
   char *tocode2, *fromcode2;
   char *tmp;
+  struct iconv_cache_t *c, *slot = NULL;
+  int i;
 
   iconv_t cd;
 
+  for (i = 0; i < ICONV_CACHE_SIZE; i++)
+  {
+    c = &IconvCache[i];
+    if (!c->used)
+    {
+      if (!slot || slot->used)
+	slot = c;
+      continue;
+    }
+    if (!c->busy && c->flags == flags && !mutt_strcmp (c->tocode, tocode)
+	&& !mutt_strcmp (c->fromcode, fromcode))
+    {
+      c->used = ++IconvCacheStamp;
+      if (c->cd != (iconv_t)(-1))
+	c->busy = 1;
+      return c->cd;
+    }
+    if (!c->busy && (!slot || (slot->used && c->used < slot->used)))
+      slot = c;
+  }
+
   /* transform to MIME preferred charset names */
   mutt_canonical_charset (tocode1, sizeof (tocode1), tocode);
   mutt_canonical_charset (fromcode1, sizeof (fromcode1), fromcode);
@@ -386,10 +472,112 @@ iconv_t mutt_iconv_open (const char *tocode, const char *fromcode, int flags)
   fromcode2 = (fromcode2) ? fromcode2 : fromcode1;
 
   /* call system iconv with names it appreciates */
-  if ((cd = iconv_open (tocode2, fromcode2)) != (iconv_t) -1)
+  cd = iconv_open (tocode2, fromcode2);
+
+  /* every slot is in use: hand out an uncached descriptor */
+  if (!slot)
     return cd;
-  
-  return (iconv_t) -1;
+
+  iconv_cache_clear (slot);
+  slot->tocode = safe_strdup (tocode);
+  slot->fromcode = safe_strdup (fromcode);
+  slot->flags = flags;
+  slot->cd = cd;
+  slot->used = ++IconvCacheStamp;
+  slot->busy = (cd != (iconv_t)(-1));
+  slot->ascii = charset_is_ascii_superset (tocode2)
+    && charset_is_ascii_superset (fromcode2);
+  slot->utf8 = mutt_is_utf8 (tocode2) && mutt_is_utf8 (fromcode2);
+
+  return cd;
+}
+
+static struct iconv_cache_t *iconv_cache_find (iconv_t cd)
+{
+  int i;
+
+  if (cd == (iconv_t)(-1))
+    return NULL;
+  for (i = 0; i < ICONV_CACHE_SIZE; i++)
+    if (IconvCache[i].busy && IconvCache[i].cd == cd)
+      return &IconvCache[i];
+  return NULL;
+}
+
+/* Release a descriptor obtained from mutt_iconv_open(). */
+void mutt_iconv_close (iconv_t cd)
+{
+  struct iconv_cache_t *c;
+
+  if (cd == (iconv_t)(-1))
+    return;
+  if ((c = iconv_cache_find (cd)))
+  {
+    iconv (cd, NULL, NULL, NULL, NULL);
+    c->busy = 0;
+  }
+  else
+    iconv_close (cd);
+}
+
+/* Strict UTF-8 check: no overlong forms, surrogates or values past
+ * U+10FFFF, i.e. exactly what iconv would pass through unchanged. */
+static int valid_utf8 (const unsigned char *s, size_t len)
+{
+  const unsigned char *e = s + len;
+  int n;
+
+  while (s < e)
+  {
+    if (*s < 0x80)
+    {
+      s++;
+      continue;
+    }
+    if (*s >= 0xc2 && *s <= 0xdf)
+      n = 1;
+    else if (*s >= 0xe0 && *s <= 0xef)
+    {
+      n = 2;
+      if (e - s > 1 && ((*s == 0xe0 && s[1] < 0xa0) || (*s == 0xed && s[1] > 0x9f)))
+	return 0;
+    }
+    else if (*s >= 0xf0 && *s <= 0xf4)
+    {
+      n = 3;
+      if (e - s > 1 && ((*s == 0xf0 && s[1] < 0x90) || (*s == 0xf4 && s[1] > 0x8f)))
+	return 0;
+    }
+    else
+      return 0;
+    if (e - s <= n)
+      return 0;
+    for (s++; n; n--, s++)
+      if ((*s & 0xc0) != 0x80)
+	return 0;
+  }
+  return 1;
+}
+
+/*
+ * Returns non-zero when converting (s, len) with cd would copy it
+ * unchanged, so the caller can skip iconv altogether: us-ascii input
+ * between two ascii-compatible charsets, or valid utf-8 converted to
+ * utf-8.
+ */
+int mutt_iconv_is_noop (iconv_t cd, const char *s, size_t len)
+{
+  struct iconv_cache_t *c;
+  const unsigned char *p, *e;
+
+  if (!(c = iconv_cache_find (cd)) || !(c->ascii || c->utf8))
+    return 0;
+
+  for (p = (const unsigned char *) s, e = p + len; p < e && *p < 0x80; p++)
+    ;
+  if (p == e)
+    return c->ascii;
+  return c->utf8 && valid_utf8 (p, e - p);
 }
 
 
@@ -498,12 +686,18 @@ int mutt_convert_string (char **ps, const char *from, const char *to, int flags)
       outrepl = "?";
       
     len = strlen (s);
+    if (mutt_iconv_is_noop (cd, s, len))
+    {
+      mutt_iconv_close (cd);
+      return 0;
+    }
+
     ib = s, ibl = len + 1;
     obl = MB_LEN_MAX * ibl;
     ob = buf = safe_malloc (obl + 1);
     
     mutt_iconv (cd, &ib, &ibl, &ob, &obl, inrepls, outrepl);
-    iconv_close (cd);
+    mutt_iconv_close (cd);
 
     *ob = '\0';
 
@@ -649,7 +843,7 @@ void fgetconv_close (FGETCONV **_fc)
   struct fgetconv_s *fc = (struct fgetconv_s *) *_fc;
 
   if (fc->cd != (iconv_t)-1)
-    iconv_close (fc->cd);
+    mutt_iconv_close (fc->cd);
   FREE (_fc);		/* __FREE_CHECKED__ */
 }
 
@@ -671,7 +865,7 @@ int mutt_check_charset (const char *s, int strict)
 
   if ((cd = mutt_iconv_open (s, s, 0)) != (iconv_t)(-1))
   {
-    iconv_close (cd);
+    mutt_iconv_close (cd);
     return 0;
   }
 
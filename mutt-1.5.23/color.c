@@ -501,6 +501,7 @@ int is_index)
                                 mutt_free_color_line(&tmp, 1);
                                 return -1;
                         }
+                        tmp->deps = mutt_pattern_deps (tmp->color_pattern);
 /* force re-caching of index colors */
                         for (i = 0; Context && i < Context->msgcount; i++)
                                 Context->hdrs[i]->pair = 0;
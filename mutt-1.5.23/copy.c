@@ -358,7 +358,22 @@ mutt_copy_header (FILE *in, HEADER *h, FILE *out, int flags, const char *prefix)
                 fputc ('\n', out);
         }
 
-        if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0) {
+        if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0 &&
+        (flags & CH_PAD_STATUS)) {
+/* always write both fields at their widest, so that later flag changes
+ * can be written into the mailbox in place (see mbox_sync_mailbox())
+ */
+                char xstatus[3], *p = xstatus;
+
+                if (h->replied)
+                        *p++ = 'A';
+                if (h->flagged)
+                        *p++ = 'F';
+                *p = 0;
+                fprintf (out, "Status: %-2s\nX-Status: %-2s\n",
+                        h->read ? "RO" : (h->old ? "O" : ""), xstatus);
+        }
+        else if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0) {
                 if (h->old || h->read) {
                         fputs ("Status: ", out);
                         if (h->read)
@@ -432,6 +447,8 @@ static int count_delete_lines (FILE *fp, BODY *b, LOFF_T *length, size_t datelen
  *
  * fpout	where to write output
  * fpin		where to get input
+ * msg		the open message fpin belongs to, or NULL; when mapped,
+ *		the raw body is written straight from memory
  * hdr		header of message being copied
  * body		structure of message being copied
  * flags
@@ -446,13 +463,15 @@ static int count_delete_lines (FILE *fp, BODY *b, LOFF_T *length, size_t datelen
  * chflags	flags to mutt_copy_header()
  */
 
-int
-_mutt_copy_message (FILE *fpout, FILE *fpin, HEADER *hdr, BODY *body,
+static int
+copy_message (FILE *fpout, FILE *fpin, MESSAGE *msg, HEADER *hdr, BODY *body,
 int flags, int chflags)
 {
         char prefix[SHORT_STRING];
         STATE s;
         LOFF_T new_offset = -1;
+        const char *data;
+        size_t avail;
         int rc = 0;
 
         if (flags & M_CM_PREFIX) {
@@ -615,6 +634,12 @@ int flags, int chflags)
                                 }
                         }
                 }
+                else if ((data = mx_message_data (msg, body->offset, &avail)) &&
+                        avail >= body->length) {
+/* the body is mapped: write it out in one go */
+                        if (fwrite (data, 1, body->length, fpout) != body->length)
+                                return -1;
+                }
                 else if (mutt_copy_bytes (fpin, fpout, body->length) == -1)
                         return -1;
         }
@@ -629,6 +654,14 @@ int flags, int chflags)
 }
 
 
+int
+_mutt_copy_message (FILE *fpout, FILE *fpin, HEADER *hdr, BODY *body,
+int flags, int chflags)
+{
+        return copy_message (fpout, fpin, NULL, hdr, body, flags, chflags);
+}
+
+
 /* should be made to return -1 on fatal errors, and 1 on non-fatal errors
  * like partial decode, where it is worth displaying as much as possible */
 int
@@ -640,7 +673,7 @@ int chflags)
 
         if ((msg = mx_open_message (src, hdr->msgno)) == NULL)
                 return -1;
-        if ((r = _mutt_copy_message (fpout, msg->fp, hdr, hdr->content, flags, chflags)) == 0
+        if ((r = copy_message (fpout, msg->fp, msg, hdr, hdr->content, flags, chflags)) == 0
         && (ferror (fpout) || feof (fpout))) {
                 dprint (1, (debugfile, "_mutt_copy_message failed to detect EOF!\n"));
                 r = -1;
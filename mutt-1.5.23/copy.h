@@ -53,6 +53,7 @@
 #define CH_UPDATE_IRT     (1<<16)                 /* update In-Reply-To: */
 #define CH_UPDATE_REFS    (1<<17)                 /* update References: */
 #define CH_DISPLAY        (1<<18)                 /* display result to user */
+#define CH_PAD_STATUS     (1<<19)                 /* reserve room in status and x-status fields */
 
 int mutt_copy_hdr (FILE *, FILE *, LOFF_T, LOFF_T, int, const char *);
 
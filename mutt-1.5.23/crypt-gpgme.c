@@ -35,6 +35,7 @@
 #include "copy.h"
 #include "pager.h"
 #include "sort.h"
+#include "md5.h"
 
 #include <sys/wait.h>
 #include <string.h>
@@ -118,9 +119,29 @@ typedef struct crypt_entry
         crypt_key_t *key;
 } crypt_entry_t;
 
+/* A cached signature verification: the digest identifies the signed
+   data, the signature and the way it was displayed, TEXT holds what was
+   written to the state and FPR the key to make the signature key again. */
+#define VERIFY_CACHE_SIZE 32
+#define VERIFY_CACHE_TTL  3600
+
+typedef struct verify_cache
+{
+        unsigned char digest[16];
+        int result;
+        char *text;
+        size_t textlen;
+        char *fpr;
+        time_t stored;
+        unsigned long stamp;
+} verify_cache_t;
+
 static struct crypt_cache *id_defaults = NULL;
 static gpgme_key_t signature_key = NULL;
 static char *current_sender = NULL;
+static gpgme_ctx_t ContextPool[2];        /* OpenPGP, CMS */
+static verify_cache_t VerifyCache[VERIFY_CACHE_SIZE];
+static int VerifyCacheNext = 0;
 
 /*
  * General helper functions.
@@ -345,6 +366,12 @@ static gpgme_ctx_t create_gpgme_context (int for_smime)
         gpgme_error_t err;
         gpgme_ctx_t ctx;
 
+        if (ContextPool[for_smime ? 1 : 0]) {
+                ctx = ContextPool[for_smime ? 1 : 0];
+                ContextPool[for_smime ? 1 : 0] = NULL;
+                return ctx;
+        }
+
         err = gpgme_new (&ctx);
         if (err) {
                 mutt_error (_("error creating gpgme context: %s\n"), gpgme_strerror (err));
@@ -366,6 +393,30 @@ static gpgme_ctx_t create_gpgme_context (int for_smime)
 }
 
 
+/* Return a context obtained from create_gpgme_context.  The context
+   is reset and kept for the next caller asking for the same protocol,
+   which saves spawning and configuring a fresh engine every time. */
+static void release_gpgme_context (gpgme_ctx_t ctx)
+{
+        int i;
+
+        if (!ctx)
+                return;
+
+        i = gpgme_get_protocol (ctx) == GPGME_PROTOCOL_CMS;
+        if (ContextPool[i]) {
+                gpgme_release (ctx);
+                return;
+        }
+
+        gpgme_set_armor (ctx, 0);
+        gpgme_set_textmode (ctx, 0);
+        gpgme_signers_clear (ctx);
+        gpgme_sig_notation_clear (ctx);
+        ContextPool[i] = ctx;
+}
+
+
 /* Create a new gpgme data object.  This is a wrapper to die on
    error. */
 static gpgme_data_t create_gpgme_data (void)
@@ -624,7 +675,7 @@ static int set_signer (gpgme_ctx_t ctx, int for_smime)
         if (!err)
                 err = gpgme_op_keylist_next (listctx, &key);
         if (err) {
-                gpgme_release (listctx);
+                release_gpgme_context (listctx);
                 mutt_error (_("secret key `%s' not found: %s\n"),
                         signid, gpgme_strerror (err));
                 return -1;
@@ -633,13 +684,13 @@ static int set_signer (gpgme_ctx_t ctx, int for_smime)
         if (!err) {
                 gpgme_key_release (key);
                 gpgme_key_release (key2);
-                gpgme_release (listctx);
+                release_gpgme_context (listctx);
                 mutt_error (_("ambiguous specification of secret key `%s'\n"),
                         signid);
                 return -1;
         }
         gpgme_op_keylist_end (listctx);
-        gpgme_release (listctx);
+        release_gpgme_context (listctx);
 
         gpgme_signers_clear (ctx);
         err = gpgme_signers_add (ctx, key);
@@ -693,7 +744,7 @@ int use_smime, int combined_signed)
         if (combined_signed) {
                 if (set_signer (ctx, use_smime)) {
                         gpgme_data_release (ciphertext);
-                        gpgme_release (ctx);
+                        release_gpgme_context (ctx);
                         return NULL;
                 }
 
@@ -701,7 +752,7 @@ int use_smime, int combined_signed)
                         err = set_pka_sig_notation (ctx);
                         if (err) {
                                 gpgme_data_release (ciphertext);
-                                gpgme_release (ctx);
+                                release_gpgme_context (ctx);
                                 return NULL;
                         }
                 }
@@ -716,11 +767,11 @@ int use_smime, int combined_signed)
         if (err) {
                 mutt_error (_("error encrypting data: %s\n"), gpgme_strerror (err));
                 gpgme_data_release (ciphertext);
-                gpgme_release (ctx);
+                release_gpgme_context (ctx);
                 return NULL;
         }
 
-        gpgme_release (ctx);
+        release_gpgme_context (ctx);
 
         outfile = data_object_to_tempfile (ciphertext, NULL);
         gpgme_data_release (ciphertext);
@@ -809,7 +860,7 @@ static BODY *sign_message (BODY *a, int use_smime)
 
         if (set_signer (ctx, use_smime)) {
                 gpgme_data_release (signature);
-                gpgme_release (ctx);
+                release_gpgme_context (ctx);
                 return NULL;
         }
 
@@ -818,7 +869,7 @@ static BODY *sign_message (BODY *a, int use_smime)
                 if (err) {
                         gpgme_data_release (signature);
                         gpgme_data_release (message);
-                        gpgme_release (ctx);
+                        release_gpgme_context (ctx);
                         return NULL;
                 }
         }
@@ -828,7 +879,7 @@ static BODY *sign_message (BODY *a, int use_smime)
         gpgme_data_release (message);
         if (err) {
                 gpgme_data_release (signature);
-                gpgme_release (ctx);
+                release_gpgme_context (ctx);
                 mutt_error (_("error signing data: %s\n"), gpgme_strerror (err));
                 return NULL;
         }
@@ -838,7 +889,7 @@ static BODY *sign_message (BODY *a, int use_smime)
         sigres = gpgme_op_sign_result (ctx);
         if (!sigres->signatures) {
                 gpgme_data_release (signature);
-                gpgme_release (ctx);
+                release_gpgme_context (ctx);
                 mutt_error (_("$pgp_sign_as unset and no default key specified in ~/.gnupg/gpg.conf"));
                 return NULL;
         }
@@ -846,7 +897,7 @@ static BODY *sign_message (BODY *a, int use_smime)
         sigfile = data_object_to_tempfile (signature, NULL);
         gpgme_data_release (signature);
         if (!sigfile) {
-                gpgme_release (ctx);
+                release_gpgme_context (ctx);
                 return NULL;
         }
 
@@ -868,7 +919,7 @@ static BODY *sign_message (BODY *a, int use_smime)
                 mutt_set_parameter ("micalg", buf, &t->parameter);
         else if (use_smime)
                 mutt_set_parameter ("micalg", "sha1", &t->parameter);
-        gpgme_release (ctx);
+        release_gpgme_context (ctx);
 
         t->parts = a;
         a = t;
@@ -1369,6 +1420,112 @@ static int show_one_sig_status (gpgme_ctx_t ctx, int idx, STATE *s)
 }
 
 
+/* Compute the digest identifying the verification of SIGBDY over the
+   signed data in TEMPFILE as it is going to be shown in S.  Returns -1
+   if the data can't be read. */
+static int verify_cache_digest (BODY *sigbdy, STATE *s,
+const char *tempfile, int is_smime, unsigned char *digest)
+{
+        struct md5_ctx md5;
+        char buf[LONG_STRING];
+        FILE *fp;
+        LOFF_T len;
+        size_t n;
+
+        md5_init_ctx (&md5);
+
+        md5_process_bytes (&sigbdy->length, sizeof (sigbdy->length), &md5);
+        fseeko (s->fpin, sigbdy->offset, SEEK_SET);
+        for (len = sigbdy->length; len > 0; len -= n) {
+                n = fread (buf, 1, MIN (sizeof (buf), len), s->fpin);
+                if (!n)
+                        return -1;
+                md5_process_bytes (buf, n, &md5);
+        }
+
+        if ((fp = fopen (tempfile, "r")) == NULL)
+                return -1;
+        while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+                md5_process_bytes (buf, n, &md5);
+        safe_fclose (&fp);
+
+        md5_process_bytes (&is_smime, sizeof (is_smime), &md5);
+        md5_process_bytes (&s->flags, sizeof (s->flags), &md5);
+        if (s->prefix)
+                md5_process_bytes (s->prefix, strlen (s->prefix), &md5);
+        md5_finish_ctx (&md5, digest);
+
+        return 0;
+}
+
+
+/* Look up a verification with DIGEST made against the keyrings as of
+   STAMP. */
+static verify_cache_t *verify_cache_find (const unsigned char *digest,
+unsigned long stamp)
+{
+        time_t now = time (NULL);
+        int i;
+
+        for (i = 0; i < VERIFY_CACHE_SIZE; i++) {
+                verify_cache_t *vc = &VerifyCache[i];
+
+                if (vc->stored && vc->stamp == stamp
+                        && now - vc->stored < VERIFY_CACHE_TTL
+                        && !memcmp (vc->digest, digest, sizeof (vc->digest)))
+                        return vc;
+        }
+
+        return NULL;
+}
+
+
+/* Remember a verification, replacing the oldest one.  TEXT is taken
+   over by the cache. */
+static void verify_cache_store (const unsigned char *digest,
+unsigned long stamp, int result, char *text, size_t textlen, const char *fpr)
+{
+        verify_cache_t *vc = &VerifyCache[VerifyCacheNext];
+
+        VerifyCacheNext = (VerifyCacheNext + 1) % VERIFY_CACHE_SIZE;
+
+        FREE (&vc->text);
+        FREE (&vc->fpr);
+        memcpy (vc->digest, digest, sizeof (vc->digest));
+        vc->result = result;
+        vc->text = text;
+        vc->textlen = textlen;
+        vc->fpr = safe_strdup (fpr);
+        vc->stored = time (NULL);
+        vc->stamp = stamp;
+}
+
+
+/* Show a cached verification and make its key the signature key
+   again, as a fresh verification would have done. */
+static int verify_cache_replay (verify_cache_t *vc, STATE *s, int is_smime)
+{
+        gpgme_ctx_t ctx;
+
+        if (vc->textlen)
+                fwrite (vc->text, 1, vc->textlen, s->fpout);
+
+        if (signature_key) {
+                gpgme_key_release (signature_key);
+                signature_key = NULL;
+        }
+        if (vc->fpr) {
+                ctx = create_gpgme_context (is_smime);
+                if (gpgme_get_key (ctx, vc->fpr, &signature_key, 0))
+                        signature_key = NULL;
+                release_gpgme_context (ctx);
+        }
+
+        dprint (1, (debugfile, "verify_one: cached, returning %d.\n", vc->result));
+        return vc->result;
+}
+
+
 /* Do the actual verification step. With IS_SMIME set to true we
    assume S/MIME (surprise!) */
 static int verify_one (BODY *sigbdy, STATE *s,
@@ -1376,13 +1533,35 @@ const char *tempfile, int is_smime)
 {
         int badsig = -1;
         int anywarn = 0;
+        int verified = 0;
+        int rc = -1;
         int err;
         gpgme_ctx_t ctx;
         gpgme_data_t signature, message;
+        unsigned char digest[16];
+        unsigned long stamp;
+        verify_cache_t *vc;
+        char capname[_POSIX_PATH_MAX];
+        FILE *capfp = NULL, *fpout = NULL;
+
+/* A signature over the same data, shown the same way against unchanged
+   keyrings verifies the same, so reuse what was shown last time. */
+        if (s->fpout && crypt_keyring_stamp (&stamp) == 0
+                && verify_cache_digest (sigbdy, s, tempfile, is_smime, digest) == 0) {
+                if ((vc = verify_cache_find (digest, stamp)))
+                        return verify_cache_replay (vc, s, is_smime);
+
+                mutt_mktemp (capname, sizeof (capname));
+                if ((capfp = safe_fopen (capname, "w+")) != NULL) {
+                        unlink (capname);
+                        fpout = s->fpout;
+                        s->fpout = capfp;
+                }
+        }
 
         signature = file_to_data_object (s->fpin, sigbdy->offset, sigbdy->length);
         if (!signature)
-                return -1;
+                goto bail;
 
 /* We need to tell gpgme about the encoding because the backend can't
    auto-detect plain base-64 encoding which is used by S/MIME. */
@@ -1393,7 +1572,7 @@ const char *tempfile, int is_smime)
         if (err) {
                 gpgme_data_release (signature);
                 mutt_error (_("error allocating data object: %s\n"), gpgme_strerror (err));
-                return -1;
+                goto bail;
         }
         ctx = create_gpgme_context (is_smime);
 
@@ -1417,6 +1596,7 @@ const char *tempfile, int is_smime)
                 int res, idx;
                 int anybad = 0;
 
+                verified = 1;
                 if (signature_key) {
                         gpgme_key_release (signature_key);
                         signature_key = NULL;
@@ -1476,12 +1656,35 @@ const char *tempfile, int is_smime)
                 }
         }
 
-        gpgme_release (ctx);
+        release_gpgme_context (ctx);
 
         state_attach_puts (_("[-- End signature information --]\n\n"), s);
         dprint (1, (debugfile, "verify_one: returning %d.\n", badsig));
+        rc = badsig? 1: anywarn? 2 : 0;
+
+        bail:
+        if (capfp) {
+                char *text;
+                size_t textlen;
+
+                s->fpout = fpout;
+                textlen = (size_t) ftello (capfp);
+                text = safe_malloc (textlen + 1);
+                rewind (capfp);
+                textlen = fread (text, 1, textlen, capfp);
+                safe_fclose (&capfp);
+                if (textlen)
+                        fwrite (text, 1, textlen, s->fpout);
+
+                if (verified)
+                        verify_cache_store (digest, stamp, rc, text, textlen,
+                                signature_key && signature_key->subkeys
+                                ? signature_key->subkeys->fpr : NULL);
+                else
+                        FREE (&text);
+        }
 
-        return badsig? 1: anywarn? 2 : 0;
+        return rc;
 }
 
 
@@ -1575,7 +1778,7 @@ int *r_is_signed)
                         state_attach_puts (buf, s);
                 }
                 gpgme_data_release (plaintext);
-                gpgme_release (ctx);
+                release_gpgme_context (ctx);
                 return NULL;
         }
         mutt_need_hard_redraw ();
@@ -1584,7 +1787,7 @@ int *r_is_signed)
    otherwise read_mime_header has a hard time parsing the message.  */
         if (data_object_to_stream (plaintext, fpout)) {
                 gpgme_data_release (plaintext);
-                gpgme_release (ctx);
+                release_gpgme_context (ctx);
                 return NULL;
         }
         gpgme_data_release (plaintext);
@@ -1616,7 +1819,7 @@ int *r_is_signed)
                         state_attach_puts (_("[-- End signature "
                                 "information --]\n\n"), s);
         }
-        gpgme_release (ctx); ctx = NULL;
+        release_gpgme_context (ctx); ctx = NULL;
 
         fflush (fpout);
         rewind (fpout);
@@ -2243,7 +2446,7 @@ int pgp_gpgme_application_handler (BODY *m, STATE *s)
                                                 FREE (&tmpfname);
                                         }
                                 }
-                                gpgme_release (ctx);
+                                release_gpgme_context (ctx);
                         }
 
 /*
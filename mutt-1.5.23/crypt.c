@@ -87,6 +87,58 @@ void crypt_forget_passphrase (void)
 }
 
 
+/* Sum up the modification times, sizes and inodes of the keyring files
+ * gpg, gpgsm or pgp may keep, so that caches of key lookups and
+ * signature checks can tell when the keyrings change.  Returns -1 if no
+ * keyring file can be found, in which case nothing should be cached. */
+int crypt_keyring_stamp (unsigned long *stamp)
+{
+        static const char * const gpgfiles[] = {
+                "pubring.kbx", "pubring.gpg", "secring.gpg", "trustdb.gpg",
+                "private-keys-v1.d", "public-keys.d/pubring.db", "trustlist.txt", NULL
+        };
+        static const char * const pgpfiles[] = {
+                "pubring.pkr", "secring.skr", "pubring.pgp", "secring.pgp", NULL
+        };
+        char dir[_POSIX_PATH_MAX];
+        char path[_POSIX_PATH_MAX];
+        const char * const *f;
+        struct stat st;
+        unsigned long h = 0;
+        int found = 0;
+        int i;
+
+        for (i = 0; i < 2; i++) {
+                if (i == 0) {
+                        if (getenv ("GNUPGHOME"))
+                                strfcpy (dir, getenv ("GNUPGHOME"), sizeof (dir));
+                        else
+                                snprintf (dir, sizeof (dir), "%s/.gnupg", NONULL (Homedir));
+                        f = gpgfiles;
+                }
+                else {
+                        if (!getenv ("PGPPATH"))
+                                break;
+                        strfcpy (dir, getenv ("PGPPATH"), sizeof (dir));
+                        f = pgpfiles;
+                }
+
+                for (; *f; f++) {
+                        if (snprintf (path, sizeof (path), "%s/%s", dir, *f) >= sizeof (path) ||
+                            stat (path, &st) == -1)
+                                continue;
+                        h = h * 31 + (unsigned long) st.st_mtime;
+                        h = h * 31 + (unsigned long) st.st_size;
+                        h = h * 31 + (unsigned long) st.st_ino;
+                        found = 1;
+                }
+        }
+
+        *stamp = h;
+        return found ? 0 : -1;
+}
+
+
 #if defined(HAVE_SETRLIMIT) && (!defined(DEBUG))
 
 static void disable_coredumps (void)
@@ -49,6 +49,7 @@
  * buffering routines.
  */
 size_t UngetCount = 0;
+unsigned int ScreenSerial = 0;
 static size_t UngetBufLen = 0;
 static event_t *KeyEvent;
 
@@ -118,6 +118,8 @@ void index_make_entry (char *s, size_t l, MUTTMENU *menu, int num)
         HEADER *h = Context->hdrs[Context->v2r[num]];
         THREAD *tmp;
 
+        if ((Sort & SORT_MASK) == SORT_THREADS)
+                mutt_draw_thread (Context, h);
         if ((Sort & SORT_MASK) == SORT_THREADS && h->tree) {
                 flag |= M_FORMAT_TREE;            /* display the thread tree */
                 if (h->display_subject)
@@ -173,7 +175,8 @@ int index_color (int index_no)
         if (h && h->pair)
                 return h->pair;
 
-        mutt_set_header_color (Context, h);
+/* colour the rest of the screen along with this one */
+        mutt_set_header_colors (Context, index_no, MIN (Context->vcount, index_no + LINES));
         return h->pair;
 }
 
@@ -324,13 +327,9 @@ int oldcount, int index_hint)
                 }
                 else if (oldcount) {
                         for (j = 0; j < ctx->msgcount - oldcount; j++) {
-                                int k;
-
-                                for (k = 0; k < ctx->msgcount; k++) {
-                                        HEADER *h = ctx->hdrs[k];
-                                        if (h == save_new[j] && (!ctx->pattern || h->limited))
-                                                mutt_uncollapse_thread (ctx, h);
-                                }
+                                HEADER *h = save_new[j];
+                                if (!ctx->pattern || h->limited)
+                                        mutt_uncollapse_thread (ctx, h);
                         }
                         FREE (&save_new);
                         mutt_set_virtual (ctx);
@@ -528,11 +527,13 @@ int mutt_index_menu (void)
                                 DrawFullLine = 1;
                                 menu_status_line (buf, sizeof (buf), menu, NONULL (Status));
                                 DrawFullLine = 0;
-                                move (option (OPTSTATUSONTOP) ? 0 : LINES-2, 0);
-                                SETCOLOR (MT_COLOR_STATUS);
                                 set_buffystats(Context);
-                                mutt_paddstr (COLS, buf);
-                                NORMAL_COLOR;
+                                if (!menu_status_unchanged (menu, buf)) {
+                                        move (option (OPTSTATUSONTOP) ? 0 : LINES-2, 0);
+                                        SETCOLOR (MT_COLOR_STATUS);
+                                        mutt_paddstr (COLS, buf);
+                                        NORMAL_COLOR;
+                                }
                                 menu->redraw &= ~REDRAW_STATUS;
                         }
 
@@ -2098,17 +2099,72 @@ int mutt_index_menu (void)
 }
 
 
-void mutt_set_header_color (CONTEXT *ctx, HEADER *curhdr)
+/* Colour the messages without a colour between virtual positions FIRST
+ * and LAST in one pass, trying each rule on all of them in turn rather
+ * than all rules on each message.  Messages drop out as soon as a rule
+ * matches them. */
+void mutt_set_header_colors (CONTEXT *ctx, int first, int last)
+{
+        COLOR_LINE *color;
+        HEADER *h;
+        int i, pos, left = 0;
+
+        for (i = first; i < last; i++) {
+                h = ctx->hdrs[ctx->v2r[i]];
+                if (!h->pair) {
+                        h->color_rule = -1;
+                        left++;
+                }
+        }
+
+        for (color = ColorIndexList, pos = 0; color && left; color = color->next, pos++)
+        for (i = first; i < last; i++) {
+                h = ctx->hdrs[ctx->v2r[i]];
+                if (h->pair || h->color_rule != -1)
+                        continue;
+                if (mutt_pattern_exec (color->color_pattern, M_MATCH_FULL_ADDRESS, ctx, h)) {
+                        h->pair = color->pair;
+                        h->color_rule = pos;
+                        left--;
+                }
+        }
+
+        for (i = first; left && i < last; i++) {
+                h = ctx->hdrs[ctx->v2r[i]];
+                if (!h->pair && h->color_rule == -1) {
+                        h->pair = ColorDefs[MT_COLOR_NORMAL];
+                        h->color_rule = pos;
+                        left--;
+                }
+        }
+}
+
+
+/* Bring the colour of CURHDR up to date after a change to what DEPS
+ * names.  Rules before the one that gave the current colour only need
+ * another look if they depend on DEPS; the same goes for that rule
+ * itself, and the rules after it are only tried once it stops
+ * matching. */
+void mutt_update_header_color (CONTEXT *ctx, HEADER *curhdr, int deps)
 {
         COLOR_LINE *color;
+        int pos;
 
-        if (!curhdr)
-                return;
+        if (!curhdr || !curhdr->pair)
+                return;                           /* not coloured yet, index_color() will */
 
-        for (color = ColorIndexList; color; color = color->next)
-        if (mutt_pattern_exec (color->color_pattern, M_MATCH_FULL_ADDRESS, ctx, curhdr)) {
-                curhdr->pair = color->pair;
-                return;
+        for (color = ColorIndexList, pos = 0; color; color = color->next, pos++) {
+                if (pos <= curhdr->color_rule && !(color->deps & deps)) {
+                        if (pos == curhdr->color_rule)
+                                return;
+                        continue;
+                }
+                if (mutt_pattern_exec (color->color_pattern, M_MATCH_FULL_ADDRESS, ctx, curhdr)) {
+                        curhdr->pair = color->pair;
+                        curhdr->color_rule = pos;
+                        return;
+                }
         }
         curhdr->pair = ColorDefs[MT_COLOR_NORMAL];
+        curhdr->color_rule = pos;
 }
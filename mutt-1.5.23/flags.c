@@ -34,6 +34,9 @@ void _mutt_set_flag (CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
         int tagged = ctx->tagged;
         int flagged = ctx->flagged;
         int update = 0;
+        int deps = 0;
+        int h_read = h->read, h_old = h->old, h_deleted = h->deleted;
+        int h_flagged = h->flagged, h_tagged = h->tagged, h_replied = h->replied;
 
         if (ctx->readonly && flag != M_TAG)
                 return;                           /* don't modify anything if we are read-only */
@@ -230,8 +233,19 @@ void _mutt_set_flag (CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
                         break;
         }
 
-        if (update)
-                mutt_set_header_color(ctx, h);
+        if (update) {
+                if (h_read != h->read || h_old != h->old)
+                        deps |= M_DEP_READ;
+                if (h_deleted != h->deleted)
+                        deps |= M_DEP_DELETED;
+                if (h_flagged != h->flagged)
+                        deps |= M_DEP_FLAGGED;
+                if (h_tagged != h->tagged)
+                        deps |= M_DEP_TAGGED;
+                if (h_replied != h->replied)
+                        deps |= M_DEP_REPLIED;
+                mutt_update_header_color (ctx, h, deps);
+        }
 
 /* if the message status has changed, we need to invalidate the cached
  * search results so that any future search will match the current status
@@ -192,6 +192,7 @@ WHERE unsigned short Counter INITVAL (0);
 WHERE short ConnectTimeout;
 WHERE short HistSize;
 WHERE short MenuContext;
+WHERE short MessageCacheSize;
 WHERE short PagerContext;
 WHERE short PagerIndexLines;
 WHERE short ReadInc;
@@ -215,6 +216,9 @@ WHERE short SidebarWidth;
 #ifdef USE_IMAP
 WHERE short ImapKeepalive;
 WHERE short ImapPipelineDepth;
+WHERE short ImapPrefetch;
+WHERE short ImapPrefetchDelay;
+WHERE short ImapPrefetchUnread;
 #endif
 
 /* flags for received signals */
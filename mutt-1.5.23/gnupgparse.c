@@ -107,7 +107,7 @@ static void fix_uid (char *uid)
                                 memcpy (uid, buf, n);
                 }
                 FREE (&buf);
-                iconv_close (cd);
+                mutt_iconv_close (cd);
         }
 }
 
@@ -348,7 +348,7 @@ static pgp_key_t parse_pub_line (char *buf, int *is_subkey, pgp_key_t k)
 }
 
 
-pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
+static pgp_key_t pgp_list_keys (pgp_ring_t keyring, LIST * hints)
 {
         FILE *fp;
         pid_t thepid;
@@ -405,3 +405,209 @@ pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
 
         return db;
 }
+
+
+/****************
+ * The keyring index.  Rather than running $pgp_list_pubring_command
+ * for every key lookup, the whole keyring is listed once and kept in
+ * memory together with a hash of the short and long key IDs, with and
+ * without "0x".  User IDs are matched by substring, as gpg matches
+ * them, so they are not hashed.  The listing is thrown away when the
+ * keyring files, the listing command or the character set change.
+ */
+
+typedef struct pgp_keyring_entry
+{
+        pgp_key_t key;                            /* the principal key */
+        short hit;
+}
+
+
+pgp_keyring_entry_t;
+
+typedef struct pgp_keyring_index
+{
+        pgp_key_t keys;
+        pgp_keyring_entry_t *entries;
+        int nentries;
+        HASH *index;
+        LIST *tokens;                             /* storage for the hash keys */
+        unsigned long stamp;
+        char *command;
+        char *charset;
+        short ignoresub;
+        short valid;
+}
+
+
+pgp_keyring_index_t;
+
+static pgp_keyring_index_t KeyringIndex[2];
+
+static void pgp_keyring_free (pgp_keyring_index_t *ri)
+{
+        if (ri->index)
+                hash_destroy (&ri->index, NULL);
+        mutt_free_list (&ri->tokens);
+        FREE (&ri->entries);
+        pgp_free_key (&ri->keys);
+        FREE (&ri->command);
+        FREE (&ri->charset);
+        ri->nentries = 0;
+        ri->valid = 0;
+}
+
+
+static void pgp_keyring_add (pgp_keyring_index_t *ri, const char *token,
+pgp_keyring_entry_t *e)
+{
+        LIST *t = mutt_new_list ();
+
+        t->data = safe_strdup (token);
+        t->next = ri->tokens;
+        ri->tokens = t;
+        hash_insert (ri->index, t->data, e, 1);
+}
+
+
+static void pgp_keyring_add_keyid (pgp_keyring_index_t *ri, const char *keyid,
+pgp_keyring_entry_t *e)
+{
+        char buf[SHORT_STRING];
+
+        pgp_keyring_add (ri, keyid, e);
+        snprintf (buf, sizeof (buf), "0x%s", keyid);
+        pgp_keyring_add (ri, buf, e);
+
+        if (mutt_strlen (keyid) > 8) {
+                pgp_keyring_add (ri, keyid + 8, e);
+                snprintf (buf, sizeof (buf), "0x%s", keyid + 8);
+                pgp_keyring_add (ri, buf, e);
+        }
+}
+
+
+/* a subkey follows its principal key in the listing */
+#define KEYRING_MEMBER(k, main) ((k) == (main) || (k)->parent == (main))
+
+static void pgp_keyring_build (pgp_keyring_index_t *ri)
+{
+        pgp_keyring_entry_t *e;
+        pgp_key_t k;
+        int n = 0;
+
+        for (k = ri->keys; k; k = k->next)
+                if (!(k->flags & KEYFLAG_SUBKEY))
+                        n++;
+
+        ri->entries = safe_calloc (MAX (n, 1), sizeof (pgp_keyring_entry_t));
+        ri->index = hash_create (MAX (8 * n, 64), 1);
+
+        for (k = ri->keys, e = ri->entries - 1; k; k = k->next) {
+                if (!(k->flags & KEYFLAG_SUBKEY)) {
+                        (++e)->key = k;
+                        ri->nentries++;
+                }
+                else if (e < ri->entries || !KEYRING_MEMBER (k, e->key))
+                        continue;
+
+                if (k->keyid)
+                        pgp_keyring_add_keyid (ri, k->keyid, e);
+        }
+}
+
+
+/* Mark the keys a hint selects.  The hash catches the key IDs, also in
+ * their 0x forms; user IDs get the substring match gpg itself does. */
+static void pgp_keyring_mark (pgp_keyring_index_t *ri, const char *hint)
+{
+        struct hash_elem *he;
+        pgp_key_t k;
+        pgp_uid_t *a;
+        int i;
+
+        for (he = ri->index->table[ri->index->hash_string ((unsigned char *) hint, ri->index->nelem)];
+        he; he = he->next) {
+                if (!ri->index->cmp_string (he->key.strkey, hint))
+                        ((pgp_keyring_entry_t *) he->data)->hit = 1;
+        }
+
+        for (i = 0; i < ri->nentries; i++) {
+                if (ri->entries[i].hit)
+                        continue;
+                for (k = ri->entries[i].key; k && KEYRING_MEMBER (k, ri->entries[i].key); k = k->next) {
+                        if (k->keyid && mutt_stristr (k->keyid, hint))
+                                ri->entries[i].hit = 1;
+                }
+                for (a = ri->entries[i].key->address; a; a = a->next)
+                        if (mutt_stristr (a->addr, hint))
+                                ri->entries[i].hit = 1;
+        }
+}
+
+
+/* copy a principal key and its subkeys out of the index */
+static pgp_key_t *pgp_keyring_copy (pgp_key_t main, pgp_key_t *kend)
+{
+        pgp_key_t k, c, cmain = NULL;
+
+        for (k = main; k && KEYRING_MEMBER (k, main); k = k->next) {
+                c = safe_malloc (sizeof (*c));
+                memcpy (c, k, sizeof (*c));
+                c->keyid = safe_strdup (k->keyid);
+                c->address = pgp_copy_uids (k->address, c);
+                c->sigs = NULL;
+                c->next = NULL;
+                if (!cmain)
+                        cmain = c;
+                else
+                        c->parent = cmain;
+
+                *kend = c;
+                kend = &c->next;
+        }
+
+        return kend;
+}
+
+
+pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
+{
+        pgp_keyring_index_t *ri = &KeyringIndex[keyring == PGP_SECRING];
+        const char *command = keyring == PGP_SECRING ? PgpListSecringCommand : PgpListPubringCommand;
+        pgp_key_t db = NULL, *kend = &db;
+        unsigned long stamp;
+        LIST *h;
+        int i;
+
+        if (crypt_keyring_stamp (&stamp) == -1) {
+                pgp_keyring_free (ri);
+                return pgp_list_keys (keyring, hints);
+        }
+
+        if (!ri->valid || ri->stamp != stamp || mutt_strcmp (ri->command, command) ||
+                mutt_strcmp (ri->charset, Charset) || ri->ignoresub != option (OPTPGPIGNORESUB)) {
+                pgp_keyring_free (ri);
+
+                if (!(ri->keys = pgp_list_keys (keyring, NULL)))
+                        return NULL;
+
+                pgp_keyring_build (ri);
+                ri->stamp = stamp;
+                ri->command = safe_strdup (command);
+                ri->charset = safe_strdup (Charset);
+                ri->ignoresub = option (OPTPGPIGNORESUB);
+                ri->valid = 1;
+        }
+
+        for (i = 0; i < ri->nentries; i++)
+                ri->entries[i].hit = hints ? 0 : 1;
+        for (h = hints; h; h = h->next)
+                pgp_keyring_mark (ri, h->data);
+
+        for (i = 0; i < ri->nentries; i++)
+                if (ri->entries[i].hit)
+                        kend = pgp_keyring_copy (ri->entries[i].key, kend);
+
+        return db;
+}
@@ -39,6 +39,7 @@
 
 #define BUFI_SIZE 1000
 #define BUFO_SIZE 2000
+#define BUFB_SIZE 16384                           /* input blocks for the qp and base64 decoders */
 
 typedef int (*handler_t) (BODY *, STATE *);
 
@@ -177,6 +178,17 @@ int last)
 /* decode the line */
 
         for (d = dest, s = src; *s;) {
+/* copy everything up to the next '=' in one go */
+                if (*s != '=') {
+                        size_t n = (c = 0, strcspn (s, "="));
+
+                        memcpy (d, s, n);
+                        d += n;
+                        s += n;
+                        kind = -1;
+                        continue;
+                }
+
                 switch ((kind = qp_decode_triple (s, &c))) {
                                                   /* qp triple */
                         case  0: *d++ = c; s += 3; break;
@@ -202,35 +214,31 @@ int last)
 }
 
 
-/* 
+/*
  * Decode an attachment encoded with quoted-printable.
  *
- * Why doesn't this overflow any buffers?  First, it's guaranteed
- * that the length of a line grows when you _en_-code it to
- * quoted-printable.  That means that we always can store the
- * result in a buffer of at most the _same_ size.
- *
- * Now, we don't special-case if the line we read with fgets()
- * isn't terminated.  We don't care about this, since STRING > 78,
- * so corrupted input will just be corrupted a bit more.  That
- * implies that STRING+1 bytes are always sufficient to store the
- * result of qp_decode_line.
- *
- * Finally, at soft line breaks, some part of a multibyte character
- * may have been left over by mutt_convert_to_state().  This shouldn't
- * be more than 6 characters, so STRING + 7 should be sufficient
- * memory to store the decoded data.
- *
- * Just to make sure that I didn't make some off-by-one error
- * above, we just use STRING*2 for the target buffer's size.
+ * The input is read in blocks of BUFB_SIZE, and cut into lines just as
+ * fgets() into a buffer of STRING bytes would.  Overlong lines, which
+ * really shouldn't happen according to the MIME spec, are processed in
+ * chunks that way.
  *
+ * A decoded chunk is never longer than the chunk itself plus the
+ * newline added at a hard line break, so it takes at most STRING bytes.
+ * The decoded text is collected in `decline' and handed to
+ * mutt_convert_to_state() once BUFB_SIZE bytes have piled up.  That
+ * leaves more than enough room for what a chunk adds and for a partial
+ * multibyte character left over by the previous conversion.
  */
 
 static void mutt_decode_quoted (STATE *s, long len, int istext, iconv_t cd)
 {
+        char block[BUFB_SIZE];
         char line[STRING];
-        char decline[2*STRING];
+        char decline[BUFB_SIZE + 2*STRING];
+        char *p = block, *nl;
+        size_t avail = 0;                         /* bytes buffered in `block', starting at p */
         size_t l = 0;
+        size_t chunk;
         size_t linelen;                           /* number of input bytes in `line' */
         size_t l3;
 
@@ -242,16 +250,24 @@ static void mutt_decode_quoted (STATE *s, long len, int istext, iconv_t cd)
         while (len > 0) {
                 last = 0;
 
-/*
- * It's ok to use a fixed size buffer for input, even if the line turns
- * out to be longer than this.  Just process the line in chunks.  This
- * really shouldn't happen according the MIME spec, since Q-P encoded
- * lines are at most 76 characters, but we should be liberal about what
- * we accept.
- */
-                if (fgets (line, MIN ((ssize_t)sizeof (line), len + 1), s->fpin) == NULL)
+/* make sure a full chunk is buffered, unless the input ends first */
+                if (avail < sizeof (line) - 1 && avail < (size_t) len) {
+                        memmove (block, p, avail);
+                        p = block;
+                        avail += fread (block + avail, 1,
+                                MIN (sizeof (block) - avail, (size_t) len - avail), s->fpin);
+                }
+                if (!avail)
                         break;
 
+                chunk = MIN (avail, MIN (sizeof (line) - 1, (size_t) len));
+                if ((nl = memchr (p, '\n', chunk)))
+                        chunk = nl - p + 1;
+                memcpy (line, p, chunk);
+                line[chunk] = 0;
+                p += chunk;
+                avail -= chunk;
+
                 linelen = strlen(line);
                 len -= linelen;
 
@@ -268,90 +284,117 @@ static void mutt_decode_quoted (STATE *s, long len, int istext, iconv_t cd)
                         line[linelen]=0;
                 }
 
-/* decode and do character set conversion */
+/* decode, and do character set conversion in large pieces */
                 qp_decode_line (decline + l, line, &l3, last);
                 l += l3;
-                mutt_convert_to_state (cd, decline, &l, s);
+                if (l >= BUFB_SIZE)
+                        mutt_convert_to_state (cd, decline, &l, s);
         }
 
+        mutt_convert_to_state (cd, decline, &l, s);
         mutt_convert_to_state (cd, 0, 0, s);
         state_reset_prefix(s);
 }
 
 
-void mutt_decode_base64 (STATE *s, long len, int istext, iconv_t cd)
+/* turn CRLF into LF in place, returns the new length.  A CR at the very
+ * end is left alone, since the LF may still be coming. */
+static size_t fold_crlf (char *buf, size_t n)
 {
-        char buf[5];
-        int c1, c2, c3, c4, ch, cr = 0, i;
-        char bufi[BUFI_SIZE];
-        size_t l = 0;
-
-        buf[4] = 0;
-
-        if (istext)
-                state_set_prefix(s);
-
-        while (len > 0) {
-                for (i = 0 ; i < 4 && len > 0 ; len--) {
-                        if ((ch = fgetc (s->fpin)) == EOF)
-                                break;
-                        if (ch >= 0 && ch < 128 && (base64val(ch) != -1 || ch == '='))
-                                buf[i++] = ch;
-                }
-                if (i != 4) {
-/* "i" may be zero if there is trailing whitespace, which is not an error */
-                        if (i != 0)
-                                dprint (2, (debugfile, "%s:%d [mutt_decode_base64()]: "
-                                        "didn't get a multiple of 4 chars.\n", __FILE__, __LINE__));
-                        break;
+        char *r = buf, *w = buf, *q = buf, *p, *end = buf + n;
+
+        while ((p = memchr (q, '\r', end - q)) && p + 1 < end) {
+                if (p[1] == '\n') {
+                        if (w != r)
+                                memmove (w, r, p - r);
+                        w += p - r;
+                        r = p + 1;
                 }
+                q = p + 1;
+        }
+        if (w != r)
+                memmove (w, r, end - r);
 
-                c1 = base64val (buf[0]);
-                c2 = base64val (buf[1]);
-                ch = (c1 << 2) | (c2 >> 4);
+        return (w - buf) + (end - r);
+}
 
-                if (cr && ch != '\n')
-                        bufi[l++] = '\r';
 
-                cr = 0;
+/*
+ * Decode base64.  The input is read in blocks of BUFB_SIZE and decoded
+ * through the Index_64 table.  In text mode CRLF is folded to LF
+ * afterwards, a block at a time, holding back a CR at the end of a block
+ * until the next one shows whether a LF follows.
+ */
+void mutt_decode_base64 (STATE *s, long len, int istext, iconv_t cd)
+{
+        char block[BUFB_SIZE];
+        char bufi[BUFB_SIZE];
+        char buf[4];
+        unsigned char *p, *end;
+        int c1, c2, c3, c4, cr = 0, i = 0, done = 0;
+        size_t n, l = 0, start;
 
-                if (istext && ch == '\r')
-                        cr = 1;
-                else
-                        bufi[l++] = ch;
+        if (istext)
+                state_set_prefix(s);
 
-                if (buf[2] == '=')
+        while (len > 0 && !done) {
+                if (!(n = fread (block, 1, MIN (sizeof (block), (size_t) len), s->fpin)))
                         break;
-                c3 = base64val (buf[2]);
-                ch = ((c2 & 0xf) << 4) | (c3 >> 2);
+                len -= n;
 
-                if (cr && ch != '\n')
+                start = l;
+                if (cr) {
                         bufi[l++] = '\r';
+                        cr = 0;
+                }
 
-                cr = 0;
+                for (p = (unsigned char *) block, end = p + n; p < end; p++) {
+                        if (*p >= 128 || (base64val (*p) == -1 && *p != '='))
+                                continue;
+                        buf[i++] = *p;
+                        if (i < 4)
+                                continue;
+                        i = 0;
 
-                if (istext && ch == '\r')
-                        cr = 1;
-                else
-                        bufi[l++] = ch;
+                        c1 = base64val (buf[0]);
+                        c2 = base64val (buf[1]);
+                        bufi[l++] = (c1 << 2) | (c2 >> 4);
+
+                        if (buf[2] == '=') {
+                                done = 1;
+                                break;
+                        }
+                        c3 = base64val (buf[2]);
+                        bufi[l++] = ((c2 & 0xf) << 4) | (c3 >> 2);
 
-                if (buf[3] == '=') break;
-                c4 = base64val (buf[3]);
-                ch = ((c3 & 0x3) << 6) | c4;
+                        if (buf[3] == '=') {
+                                done = 1;
+                                break;
+                        }
+                        c4 = base64val (buf[3]);
+                        bufi[l++] = ((c3 & 0x3) << 6) | c4;
+                }
 
-                if (cr && ch != '\n')
-                        bufi[l++] = '\r';
-                cr = 0;
+/* leave the input right after the padding, as reading stops there */
+                if (done && end - p > 1)
+                        fseeko (s->fpin, -(LOFF_T) (end - p - 1), SEEK_CUR);
 
-                if (istext && ch == '\r')
-                        cr = 1;
-                else
-                        bufi[l++] = ch;
+                if (istext) {
+                        l = start + fold_crlf (bufi + start, l - start);
+                        if (l > start && bufi[l - 1] == '\r') {
+                                l--;
+                                cr = 1;
+                        }
+                }
 
-                if (l + 8 >= sizeof (bufi))
-                        mutt_convert_to_state (cd, bufi, &l, s);
+                mutt_convert_to_state (cd, bufi, &l, s);
         }
 
+/* "i" may be zero if there is trailing whitespace, which is not an error */
+        if (!done && i != 0)
+                dprint (2, (debugfile, "%s:%d [mutt_decode_base64()]: "
+                        "didn't get a multiple of 4 chars.\n", __FILE__, __LINE__));
+
         if (cr) bufi[l++] = '\r';
 
         mutt_convert_to_state (cd, bufi, &l, s);
@@ -361,6 +404,7 @@ void mutt_decode_base64 (STATE *s, long len, int istext, iconv_t cd)
 }
 
 
+
 static unsigned char decode_byte (char ch)
 {
         if (ch == 96)
@@ -1445,7 +1489,7 @@ void mutt_decode_attachment (BODY *b, STATE *s)
         }
 
         if (cd != (iconv_t)(-1))
-                iconv_close (cd);
+                mutt_iconv_close (cd);
 }
 
 
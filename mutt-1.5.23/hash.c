@@ -84,7 +84,7 @@ int hash_insert (HASH * table, const char *key, void *data, int allow_dup)
 
         ptr = (struct hash_elem *) safe_malloc (sizeof (struct hash_elem));
         h = table->hash_string ((unsigned char *) key, table->nelem);
-        ptr->key = key;
+        ptr->key.strkey = key;
         ptr->data = data;
 
         if (allow_dup) {
@@ -96,7 +96,7 @@ int hash_insert (HASH * table, const char *key, void *data, int allow_dup)
                 int r;
 
                 for (tmp = table->table[h], last = NULL; tmp; last = tmp, tmp = tmp->next) {
-                        r = table->cmp_string (tmp->key, key);
+                        r = table->cmp_string (tmp->key.strkey, key);
                         if (r == 0) {
                                 FREE (&ptr);
                                 return (-1);
@@ -118,7 +118,7 @@ void *hash_find_hash (const HASH * table, int hash, const char *key)
 {
         struct hash_elem *ptr = table->table[hash];
         for (; ptr; ptr = ptr->next) {
-                if (table->cmp_string (key, ptr->key) == 0)
+                if (table->cmp_string (key, ptr->key.strkey) == 0)
                         return (ptr->data);
         }
         return NULL;
@@ -133,7 +133,74 @@ void (*destroy) (void *))
 
         while (ptr) {
                 if ((data == ptr->data || !data)
-                && table->cmp_string (ptr->key, key) == 0) {
+                && table->cmp_string (ptr->key.strkey, key) == 0) {
+                        *last = ptr->next;
+                        if (destroy)
+                                destroy (ptr->data);
+                        FREE (&ptr);
+
+                        ptr = *last;
+                }
+                else {
+                        last = &ptr->next;
+                        ptr = ptr->next;
+                }
+        }
+}
+
+
+HASH *int_hash_create (int nelem)
+{
+        HASH *table = hash_create (nelem, 0);
+
+        table->hash_string = NULL;
+        table->cmp_string = NULL;
+        return table;
+}
+
+
+int int_hash_insert (HASH * table, unsigned int key, void *data, int allow_dup)
+{
+        struct hash_elem *ptr, *tmp;
+        unsigned int h = key % table->nelem;
+
+        if (!allow_dup) {
+                for (tmp = table->table[h]; tmp; tmp = tmp->next)
+                        if (tmp->key.intkey == key)
+                                return (-1);
+        }
+
+        ptr = (struct hash_elem *) safe_malloc (sizeof (struct hash_elem));
+        ptr->key.intkey = key;
+        ptr->data = data;
+        ptr->next = table->table[h];
+        table->table[h] = ptr;
+
+        return h;
+}
+
+
+void *int_hash_find (const HASH * table, unsigned int key)
+{
+        struct hash_elem *ptr = table->table[key % table->nelem];
+
+        for (; ptr; ptr = ptr->next) {
+                if (ptr->key.intkey == key)
+                        return (ptr->data);
+        }
+        return NULL;
+}
+
+
+void int_hash_delete (HASH * table, unsigned int key, const void *data,
+void (*destroy) (void *))
+{
+        unsigned int h = key % table->nelem;
+        struct hash_elem *ptr = table->table[h];
+        struct hash_elem **last = &table->table[h];
+
+        while (ptr) {
+                if ((data == ptr->data || !data) && ptr->key.intkey == key) {
                         *last = ptr->next;
                         if (destroy)
                                 destroy (ptr->data);
@@ -19,9 +19,15 @@
 #ifndef _HASH_H
 #define _HASH_H
 
+union hash_key
+{
+        const char *strkey;
+        unsigned int intkey;
+};
+
 struct hash_elem
 {
-        const char *key;
+        union hash_key key;
         void *data;
         struct hash_elem *next;
 };
@@ -47,4 +53,11 @@ void *hash_find_hash (const HASH * table, int hash, const char *key);
 void hash_delete_hash (HASH * table, int hash, const char *key, const void *data,
 void (*destroy) (void *));
 void hash_destroy (HASH ** hash, void (*destroy) (void *));
+
+/* tables keyed on unsigned integers (eg IMAP UIDs) rather than strings */
+HASH *int_hash_create (int nelem);
+int int_hash_insert (HASH * table, unsigned int key, void *data, int allow_dup);
+void *int_hash_find (const HASH * table, unsigned int key);
+void int_hash_delete (HASH * table, unsigned int key, const void *data,
+void (*destroy) (void *));
 #endif
@@ -375,6 +375,98 @@ restore_parameter(PARAMETER ** p, const unsigned char *d, int *off, int convert)
 }
 
 
+static unsigned char *dump_body(BODY *, unsigned char *, int *, int);
+static void restore_body(BODY *, const unsigned char *, int *, int);
+static unsigned char *dump_envelope(ENVELOPE *, unsigned char *, int *, int);
+static void restore_envelope(ENVELOPE *, const unsigned char *, int *, int);
+
+
+/* The parsed MIME structure of a message is cached along with its
+ * header, so that multipart messages need not be reread and reparsed
+ * every time they are viewed or their attachments counted.  The
+ * header of a message/rfc822 part shares its content with the parts
+ * of that body, so only its own fields and envelope are stored.
+ */
+static unsigned char *
+dump_parts(BODY * c, unsigned char *d, int *off, int convert)
+{
+        unsigned int counter = 0;
+        unsigned int start_off = *off;
+        BODY *p;
+
+        d = dump_int(0xdeadbeef, d, off);
+
+        for (p = c->parts; p; p = p->next) {
+                d = dump_body(p, d, off, convert);
+                counter++;
+        }
+
+        memcpy(d + start_off, &counter, sizeof (int));
+
+        if (c->hdr && c->parts && c->hdr->content == c->parts) {
+                HEADER nh;
+
+                memcpy(&nh, c->hdr, sizeof (HEADER));
+                nh.env = NULL;
+                nh.content = NULL;
+                nh.path = NULL;
+                nh.tree = NULL;
+                nh.thread = NULL;
+#ifdef MIXMASTER
+                nh.chain = NULL;
+#endif
+#if defined USE_POP || defined USE_IMAP
+                nh.data = NULL;
+#endif
+                nh.maildir_flags = NULL;
+                nh.score_bits = NULL;
+
+                d = dump_int(1, d, off);
+                lazy_realloc(&d, *off + sizeof (HEADER));
+                memcpy(d + *off, &nh, sizeof (HEADER));
+                *off += sizeof (HEADER);
+
+                d = dump_envelope(c->hdr->env, d, off, convert);
+        }
+        else
+                d = dump_int(0, d, off);
+
+        return d;
+}
+
+
+static void
+restore_parts(BODY * c, const unsigned char *d, int *off, int convert)
+{
+        unsigned int counter;
+        unsigned int has_hdr;
+        BODY **p = &c->parts;
+
+        restore_int(&counter, d, off);
+
+        while (counter) {
+                *p = mutt_new_body();
+                restore_body(*p, d, off, convert);
+                p = &(*p)->next;
+                counter--;
+        }
+
+        *p = NULL;
+
+        restore_int(&has_hdr, d, off);
+        if (!has_hdr)
+                return;
+
+        c->hdr = mutt_new_header();
+        memcpy(c->hdr, d + *off, sizeof (HEADER));
+        *off += sizeof (HEADER);
+
+        c->hdr->env = mutt_new_envelope();
+        restore_envelope(c->hdr->env, d, off, convert);
+        c->hdr->content = c->parts;
+}
+
+
 static unsigned char *
 dump_body(BODY * c, unsigned char *d, int *off, int convert)
 {
@@ -404,6 +496,8 @@ dump_body(BODY * c, unsigned char *d, int *off, int convert)
         d = dump_char(nb.filename, d, off, convert);
         d = dump_char(nb.d_filename, d, off, convert);
 
+        d = dump_parts(c, d, off, convert);
+
         return d;
 }
 
@@ -423,6 +517,8 @@ restore_body(BODY * c, const unsigned char *d, int *off, int convert)
         restore_char(&c->form_name, d, off, convert);
         restore_char(&c->filename, d, off, convert);
         restore_char(&c->d_filename, d, off, convert);
+
+        restore_parts(c, d, off, convert);
 }
 
 
@@ -596,6 +692,49 @@ hcache_namer_t namer)
 }
 
 
+/* Hash of the attachments/unattachments rules, stored with each header
+ * so that a cached attachment count is dropped when the rules change.
+ * It is only recomputed after the rules changed, see _attachments_clean().
+ */
+static unsigned int AttachRulesHash;
+
+static unsigned int
+attach_rules_hash(void)
+{
+        LIST *lists[4];
+        LIST *l;
+        ATTACH_MATCH *a;
+        struct md5_ctx ctx;
+        unsigned char digest[16];
+        int i;
+
+        if (option(OPTATTACHRULESHASHED))
+                return AttachRulesHash;
+
+        lists[0] = AttachAllow;
+        lists[1] = AttachExclude;
+        lists[2] = InlineAllow;
+        lists[3] = InlineExclude;
+
+        md5_init_ctx(&ctx);
+        for (i = 0; i < 4; i++) {
+                for (l = lists[i]; l; l = l->next) {
+                        a = (ATTACH_MATCH *) l->data;
+                        md5_process_bytes(a->major, strlen(a->major), &ctx);
+                        md5_process_bytes("/", 1, &ctx);
+                        md5_process_bytes(a->minor, strlen(a->minor), &ctx);
+                        md5_process_bytes(";", 1, &ctx);
+                }
+                md5_process_bytes("|", 1, &ctx);
+        }
+        md5_finish_ctx(&ctx, digest);
+        memcpy(&AttachRulesHash, digest, sizeof (AttachRulesHash));
+        set_option(OPTATTACHRULESHASHED);
+
+        return AttachRulesHash;
+}
+
+
 /* This function transforms a header into a char so that it is useable by
  * db_store.
  */
@@ -636,7 +775,8 @@ unsigned int uidvalidity, mutt_hcache_store_flags_t flags)
         nh.num_hidden = 0;
         nh.recipient = 0;
         nh.pair = 0;
-        nh.attach_valid = 0;
+        nh.hcache_dirty = 0;
+        nh.score_bits = NULL;
         nh.path = NULL;
         nh.tree = NULL;
         nh.thread = NULL;
@@ -653,6 +793,7 @@ unsigned int uidvalidity, mutt_hcache_store_flags_t flags)
         d = dump_envelope(nh.env, d, off, convert);
         d = dump_body(nh.content, d, off, convert);
         d = dump_char(nh.maildir_flags, d, off, convert);
+        d = dump_int(attach_rules_hash(), d, off);
 
         return d;
 }
@@ -662,6 +803,7 @@ HEADER *
 mutt_hcache_restore(const unsigned char *d, HEADER ** oh)
 {
         int off = 0;
+        unsigned int rules;
         HEADER *h = mutt_new_header();
         int convert = !Charset_is_utf8;
 
@@ -682,6 +824,11 @@ mutt_hcache_restore(const unsigned char *d, HEADER ** oh)
 
         restore_char(&h->maildir_flags, d, &off, convert);
 
+/* the attachment count is only good for the rules it was made with */
+        restore_int(&rules, d, &off);
+        if (rules != attach_rules_hash())
+                h->attach_valid = 0;
+
 /* this is needed for maildir style mailboxes */
         if (oh) {
                 h->old = (*oh)->old;
@@ -23,6 +23,7 @@
 #include "mutt.h"
 #include "mailbox.h"
 #include "mutt_crypt.h"
+#include "rfc2047.h"
 
 #include <limits.h>
 #include <string.h>
@@ -30,24 +31,211 @@
 #include <ctype.h>
 #include <unistd.h>
 
+/* how a hook's pattern is matched, worked out when it is defined */
+#define HOOK_REGEXP  0                            /* regexec() */
+#define HOOK_EXACT   1                            /* ^literal$, through the hash of its list */
+#define HOOK_PREFIX  2                            /* ^literal */
+#define HOOK_SUBSTR  3                            /* literal */
+#define HOOK_ALL     4                            /* ~A */
+
+/* hooks whose command is a line of muttrc commands */
+#define M_COMMANDHOOK (M_FOLDERHOOK | M_SENDHOOK | M_SEND2HOOK | M_MESSAGEHOOK | M_ACCOUNTHOOK | M_REPLYHOOK)
+
 typedef struct hook
 {
         int type;                                 /* hook type */
         REGEXP rx;                                /* regular expression */
         char *command;                            /* filename, command or pattern to execute */
         pattern_t *pattern;                       /* used for fcc,save,send-hook */
-        struct hook *next;
+        int kind;                                 /* HOOK_* */
+        char *literal;                            /* what kind matches against, unescaped */
+        size_t litlen;
+        int cmd;                                  /* command's index for mutt_run_rc_command() or -1 */
+        size_t args;                              /* where the command's arguments start */
 } HOOK;
 
-static HOOK *Hooks = NULL;
+/* a hook's place in a list; a hook of several types, like fcc-save-hook,
+ * is in the list of each */
+typedef struct hook_ref
+{
+        HOOK *hook;
+        const char *key;                          /* literal as stored in the hash, for HOOK_EXACT */
+        unsigned int serial;                      /* order in which it was added to the list */
+        struct hook_ref *next;
+} HOOK_REF;
+
+/* the hooks of one type, in the order they were defined */
+typedef struct hook_list
+{
+        HOOK_REF *first;
+        HOOK_REF *last;
+        HASH *exact;                              /* HOOK_EXACT literals */
+        unsigned int added;                       /* serial of the next reference */
+        int icase;                                /* regexps of this type ignore case */
+} HOOK_LIST;
+
+static HOOK_LIST Hooks[12];                       /* by bit of M_*HOOK */
 
 static int current_hook_type = 0;
 
+
+static HOOK_LIST *hook_list (int type)
+{
+        int i;
+
+        for (i = 0; i < 11 && !(type & (1 << i)); i++)
+                ;
+        Hooks[i].icase = (type & (M_CRYPTHOOK | M_CHARSETHOOK | M_ICONVHOOK)) ? 1 : 0;
+        return &Hooks[i];
+}
+
+
+/* If regexp S matches a plain string, copy the string to BUF and return
+ * the HOOK_* saying how, otherwise return HOOK_REGEXP. */
+static int hook_literal (const char *s, char *buf, size_t len, int icase)
+{
+        size_t n = 0;
+        int head = 0, tail = 0;
+
+        if (*s == '^') {
+                head = 1;
+                s++;
+        }
+
+        for (; *s && n < len - 1; s++) {
+                if (*s == '\\') {
+/* an escaped metacharacter stands for itself; others, like \< and \`,
+ * are GNU regex operators */
+                        if (!s[1] || !strchr (".[]()*+?{}|^$\\/", s[1]))
+                                return HOOK_REGEXP;
+                        s++;
+                }
+                else if (*s == '$' && !s[1]) {
+                        tail = 1;
+                        break;
+                }
+                else if (strchr (".[]()*+?{}|^$", *s))
+                        return HOOK_REGEXP;
+                if (icase && (*s & 0x80))
+                        return HOOK_REGEXP;      /* leave case folding of other characters to regexec() */
+                buf[n++] = *s;
+        }
+        if (*s && !tail)
+                return HOOK_REGEXP;
+        buf[n] = 0;
+
+        if (tail)
+                return head ? HOOK_EXACT : HOOK_REGEXP;
+        return head ? HOOK_PREFIX : HOOK_SUBSTR;
+}
+
+
+/* Work out how to match HOOK quickly, and look up its command. */
+static void hook_classify (HOOK *hook, int icase)
+{
+        char buf[HUGE_STRING];
+
+        hook->cmd = -1;
+        if ((hook->type & M_COMMANDHOOK) && hook->command)
+                hook->cmd = mutt_lookup_rc_command (hook->command, &hook->args);
+
+        if (hook->pattern) {
+                hook->kind = (hook->pattern->op == M_ALL && !hook->pattern->not) ? HOOK_ALL : HOOK_REGEXP;
+                return;
+        }
+
+        hook->kind = hook_literal (NONULL (hook->rx.pattern), buf, sizeof (buf), icase);
+        if (hook->kind == HOOK_REGEXP)
+                return;
+
+        hook->literal = safe_strdup (buf);
+        hook->litlen = mutt_strlen (buf);
+}
+
+
+/* Enter the literal of REF's hook in the hash of LIST. */
+static void hook_list_key (HOOK_LIST *list, HOOK_REF *ref)
+{
+        if (ref->hook->kind != HOOK_EXACT)
+                return;
+
+        if (!list->exact)
+                list->exact = hash_create (31, list->icase);
+        if (!(ref->key = hash_find (list->exact, ref->hook->literal))) {
+                hash_insert (list->exact, ref->hook->literal, ref->hook->literal, 0);
+                ref->key = ref->hook->literal;
+        }
+}
+
+
+static void hook_list_add (HOOK_LIST *list, HOOK *hook)
+{
+        HOOK_REF *ref = safe_calloc (1, sizeof (HOOK_REF));
+
+        ref->hook = hook;
+        ref->serial = list->added++;
+        hook_list_key (list, ref);
+
+        if (list->last)
+                list->last->next = ref;
+        else
+                list->first = ref;
+        list->last = ref;
+}
+
+
+/* Look STR up in the hash of LIST, noting in SEEN which hooks the answer
+ * covers. */
+static const char *hook_lookup (HOOK_LIST *list, const char *str, unsigned int *seen)
+{
+        *seen = list->added;
+        return str && list->exact ? hash_find (list->exact, str) : NULL;
+}
+
+
+/* EXACT and SEEN are what hook_lookup() gave for STR. */
+static int hook_match (HOOK_LIST *list, HOOK_REF *ref, const char *str, const char *exact,
+                       unsigned int seen)
+{
+        HOOK *hook = ref->hook;
+
+        switch (hook->kind) {
+                case HOOK_EXACT:
+                        if (ref->serial < seen)
+                                return ref->key == exact;
+/* defined since the lookup, by the command of an earlier hook */
+                        return !(list->icase ? mutt_strcasecmp : mutt_strcmp) (str, hook->literal);
+                case HOOK_PREFIX:
+                        return !(list->icase ? mutt_strncasecmp : mutt_strncmp) (str, hook->literal, hook->litlen);
+                case HOOK_SUBSTR:
+                        return (list->icase ? mutt_stristr (str, hook->literal) : strstr (str, hook->literal)) != NULL;
+        }
+        return regexec (hook->rx.rx, str, 0, NULL, 0) == 0;
+}
+
+
+static int hook_pattern_match (HOOK *hook, CONTEXT *ctx, HEADER *hdr)
+{
+        if (hook->kind == HOOK_ALL)
+                return 1;
+        return mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0;
+}
+
+
+static int hook_run (HOOK *hook, BUFFER *token, BUFFER *err)
+{
+        if (hook->cmd >= 0)
+                return mutt_run_rc_command (hook->cmd, hook->command, hook->args, token, err);
+        return mutt_parse_rc_line (hook->command, token, err);
+}
+
 int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 {
+        HOOK_LIST *list = hook_list (data);
+        HOOK_REF *ref;
         HOOK *ptr;
         BUFFER command, pattern;
-        int rc, not = 0;
+        int i, rc, not = 0;
         regex_t *rx = NULL;
         pattern_t *pat = NULL;
         char path[_POSIX_PATH_MAX];
@@ -55,6 +243,12 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
         mutt_buffer_init (&pattern);
         mutt_buffer_init (&command);
 
+/* resolved charset names depend on these hooks */
+        if (data & (M_CHARSETHOOK | M_ICONVHOOK)) {
+                mutt_iconv_cache_flush ();
+                rfc2047_decode_cache_flush ();
+        }
+
         if (*s->dptr == '!') {
                 s->dptr++;
                 SKIPWS (s->dptr);
@@ -111,10 +305,11 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
                 command.data = safe_strdup (path);
         }
 
-/* check to make sure that a matching hook doesn't already exist */
-        for (ptr = Hooks; ptr; ptr = ptr->next) {
-                if (ptr->type == data &&
-                        ptr->rx.not == not &&
+/* check to make sure that a matching hook doesn't already exist; one of the
+ * same type is in every list of its type bits, so the first will do */
+        for (ref = list->first; ref; ref = ref->next) {
+                ptr = ref->hook;
+                if (ptr->type == data && ptr->rx.not == not &&
                 !mutt_strcmp (pattern.data, ptr->rx.pattern)) {
                         if (data & (M_FOLDERHOOK | M_SENDHOOK | M_SEND2HOOK | M_MESSAGEHOOK | M_ACCOUNTHOOK | M_REPLYHOOK)) {
 /* these hooks allow multiple commands with the same
@@ -138,8 +333,6 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
                                 return 0;
                         }
                 }
-                if (!ptr->next)
-                        break;
         }
 
         if (data & (M_SENDHOOK | M_SEND2HOOK | M_SAVEHOOK | M_FCCHOOK | M_MESSAGEHOOK | M_REPLYHOOK)) {
@@ -163,18 +356,18 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
                 }
         }
 
-        if (ptr) {
-                ptr->next = safe_calloc (1, sizeof (HOOK));
-                ptr = ptr->next;
-        }
-        else
-                Hooks = ptr = safe_calloc (1, sizeof (HOOK));
+        ptr = safe_calloc (1, sizeof (HOOK));
         ptr->type = data;
         ptr->command = command.data;
         ptr->pattern = pat;
         ptr->rx.pattern = pattern.data;
         ptr->rx.rx = rx;
         ptr->rx.not = not;
+        hook_classify (ptr, list->icase);
+
+        for (i = 0; i < sizeof (Hooks) / sizeof (Hooks[0]); i++)
+                if (data & (1 << i))
+                        hook_list_add (hook_list (1 << i), ptr);
         return 0;
 
         error:
@@ -187,6 +380,7 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 static void delete_hook (HOOK *h)
 {
         FREE (&h->command);
+        FREE (&h->literal);
         FREE (&h->rx.pattern);
         if (h->rx.rx) {
                 regfree (h->rx.rx);
@@ -199,24 +393,42 @@ static void delete_hook (HOOK *h)
 /* Deletes all hooks of type ``type'', or all defined hooks if ``type'' is 0 */
 static void delete_hooks (int type)
 {
+        HOOK_LIST *list;
+        HOOK_REF *ref, **last;
         HOOK *h;
-        HOOK *prev;
+        int i;
 
-        while (h = Hooks, h && (type == 0 || type == h->type)) {
-                Hooks = h->next;
-                delete_hook (h);
+        if (!type || (type & (M_CHARSETHOOK | M_ICONVHOOK))) {
+                mutt_iconv_cache_flush ();
+                rfc2047_decode_cache_flush ();
         }
 
-        prev = h;                                 /* Unused assignment to avoid compiler warnings */
+        for (i = 0; i < sizeof (Hooks) / sizeof (Hooks[0]); i++) {
+                list = &Hooks[i];
+                if (type && !(type & (1 << i)))
+                        continue;
 
-        while (h) {
-                if (type == h->type) {
-                        prev->next = h->next;
-                        delete_hook (h);
+                list->last = NULL;
+                for (last = &list->first; (ref = *last); ) {
+                        h = ref->hook;
+                        if (type && h->type != type) {
+                                list->last = ref;
+                                last = &ref->next;
+                                continue;
+                        }
+                        *last = ref->next;
+                        FREE (&ref);
+/* the hook is freed with its reference in the list of its highest bit */
+                        if (!(h->type >> (i + 1)))
+                                delete_hook (h);
+                }
+
+/* the hash may point to literals of deleted hooks */
+                if (list->exact) {
+                        hash_destroy (&list->exact, NULL);
+                        for (ref = list->first; ref; ref = ref->next)
+                                hook_list_key (list, ref);
                 }
-                else
-                        prev = h;
-                h = prev->next;
         }
 }
 
@@ -256,7 +468,11 @@ int mutt_parse_unhook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 
 void mutt_folder_hook (char *path)
 {
-        HOOK *tmp = Hooks;
+        HOOK_LIST *list = hook_list (M_FOLDERHOOK);
+        HOOK_REF *ref;
+        HOOK *tmp;
+        unsigned int seen;
+        const char *exact = hook_lookup (list, path, &seen);
         BUFFER err, token;
 
         current_hook_type = M_FOLDERHOOK;
@@ -265,13 +481,14 @@ void mutt_folder_hook (char *path)
         err.dsize = STRING;
         err.data = safe_malloc (err.dsize);
         mutt_buffer_init (&token);
-        for (; tmp; tmp = tmp->next) {
+        for (ref = list->first; ref; ref = ref->next) {
+                tmp = ref->hook;
                 if(!tmp->command)
                         continue;
 
                 if (tmp->type & M_FOLDERHOOK) {
-                        if ((regexec (tmp->rx.rx, path, 0, NULL, 0) == 0) ^ tmp->rx.not) {
-                                if (mutt_parse_rc_line (tmp->command, &token, &err) == -1) {
+                        if (hook_match (list, ref, path, exact, seen) ^ tmp->rx.not) {
+                                if (hook_run (tmp, &token, &err) == -1) {
                                         mutt_error ("%s", err.data);
                                         FREE (&token.data);
                                                   /* pause a moment to let the user see the error */
@@ -293,12 +510,15 @@ void mutt_folder_hook (char *path)
 
 char *mutt_find_hook (int type, const char *pat)
 {
-        HOOK *tmp = Hooks;
-
-        for (; tmp; tmp = tmp->next)
-        if (tmp->type & type) {
-                if (regexec (tmp->rx.rx, pat, 0, NULL, 0) == 0)
-                        return (tmp->command);
+        HOOK_LIST *list = hook_list (type);
+        HOOK_REF *ref;
+        unsigned int seen;
+        const char *exact = hook_lookup (list, pat, &seen);
+
+        for (ref = list->first; ref; ref = ref->next)
+        if (ref->hook->type & type) {
+                if (hook_match (list, ref, pat, exact, seen))
+                        return (ref->hook->command);
         }
         return (NULL);
 }
@@ -307,6 +527,7 @@ char *mutt_find_hook (int type, const char *pat)
 void mutt_message_hook (CONTEXT *ctx, HEADER *hdr, int type)
 {
         BUFFER err, token;
+        HOOK_REF *ref;
         HOOK *hook;
 
         current_hook_type = type;
@@ -315,13 +536,14 @@ void mutt_message_hook (CONTEXT *ctx, HEADER *hdr, int type)
         err.dsize = STRING;
         err.data = safe_malloc (err.dsize);
         mutt_buffer_init (&token);
-        for (hook = Hooks; hook; hook = hook->next) {
+        for (ref = hook_list (type)->first; ref; ref = ref->next) {
+                hook = ref->hook;
                 if(!hook->command)
                         continue;
 
                 if (hook->type & type)
-                        if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not)
-                        if (mutt_parse_rc_line (hook->command, &token, &err) != 0) {
+                        if (hook_pattern_match (hook, ctx, hdr) ^ hook->rx.not)
+                        if (hook_run (hook, &token, &err) != 0) {
                                 FREE (&token.data);
                         mutt_error ("%s", err.data);
                         mutt_sleep (1);
@@ -341,15 +563,17 @@ void mutt_message_hook (CONTEXT *ctx, HEADER *hdr, int type)
 static int
 mutt_addr_hook (char *path, size_t pathlen, int type, CONTEXT *ctx, HEADER *hdr)
 {
+        HOOK_REF *ref;
         HOOK *hook;
 
 /* determine if a matching hook exists */
-        for (hook = Hooks; hook; hook = hook->next) {
+        for (ref = hook_list (type)->first; ref; ref = ref->next) {
+                hook = ref->hook;
                 if(!hook->command)
                         continue;
 
                 if (hook->type & type)
-                if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not) {
+                if (hook_pattern_match (hook, ctx, hdr) ^ hook->rx.not) {
                         mutt_make_string (path, pathlen, hook->command, ctx, hdr);
                         return 0;
                 }
@@ -410,12 +634,15 @@ void mutt_select_fcc (char *path, size_t pathlen, HEADER *hdr)
 
 static char *_mutt_string_hook (const char *match, int hook)
 {
-        HOOK *tmp = Hooks;
-
-        for (; tmp; tmp = tmp->next) {
-                if ((tmp->type & hook) && ((match &&
-                        regexec (tmp->rx.rx, match, 0, NULL, 0) == 0) ^ tmp->rx.not))
-                        return (tmp->command);
+        HOOK_LIST *list = hook_list (hook);
+        HOOK_REF *ref;
+        unsigned int seen;
+        const char *exact = hook_lookup (list, match, &seen);
+
+        for (ref = list->first; ref; ref = ref->next) {
+                if ((ref->hook->type & hook) && ((match &&
+                        hook_match (list, ref, match, exact, seen)) ^ ref->hook->rx.not))
+                        return (ref->hook->command);
         }
         return (NULL);
 }
@@ -447,7 +674,11 @@ void mutt_account_hook (const char* url)
  * belong in a folder-hook -- perhaps we should warn the user. */
         static int inhook = 0;
 
+        HOOK_LIST *list;
+        HOOK_REF *ref;
         HOOK* hook;
+        const char *exact;
+        unsigned int seen;
         BUFFER token;
         BUFFER err;
 
@@ -459,14 +690,17 @@ void mutt_account_hook (const char* url)
         err.data = safe_malloc (err.dsize);
         mutt_buffer_init (&token);
 
-        for (hook = Hooks; hook; hook = hook->next) {
+        list = hook_list (M_ACCOUNTHOOK);
+        exact = hook_lookup (list, url, &seen);
+        for (ref = list->first; ref; ref = ref->next) {
+                hook = ref->hook;
                 if (! (hook->command && (hook->type & M_ACCOUNTHOOK)))
                         continue;
 
-                if ((regexec (hook->rx.rx, url, 0, NULL, 0) == 0) ^ hook->rx.not) {
+                if (hook_match (list, ref, url, exact, seen) ^ hook->rx.not) {
                         inhook = 1;
 
-                        if (mutt_parse_rc_line (hook->command, &token, &err) == -1) {
+                        if (hook_run (hook, &token, &err) == -1) {
                                 FREE (&token.data);
                                 mutt_error ("%s", err.data);
                                 FREE (&err.data);
@@ -50,6 +50,7 @@ static void cmd_parse_lsub (IMAP_DATA* idata, char* s);
 static void cmd_parse_fetch (IMAP_DATA* idata, char* s);
 static void cmd_parse_myrights (IMAP_DATA* idata, const char* s);
 static void cmd_parse_search (IMAP_DATA* idata, const char* s);
+static void cmd_parse_esearch (IMAP_DATA* idata, const char* s);
 static void cmd_parse_status (IMAP_DATA* idata, char* s);
 
 static const char * const Capabilities[] = {
@@ -65,6 +66,8 @@ static const char * const Capabilities[] = {
   "LOGINDISABLED",
   "IDLE",
   "SASL-IR",
+  "ESEARCH",
+  "MOVE",
 
   NULL
 };
@@ -273,6 +276,9 @@ void imap_cmd_finish (IMAP_DATA* idata)
 
   if (!(idata->state >= IMAP_SELECTED) || idata->ctx->closing)
     return;
+
+  /* renumber once for all the EXPUNGEs of the response */
+  imap_msn_compact (idata);
   
   if (idata->reopen & IMAP_REOPEN_ALLOW)
   {
@@ -520,6 +526,8 @@ static int cmd_handle_untagged (IMAP_DATA* idata)
     cmd_parse_myrights (idata, s);
   else if (ascii_strncasecmp ("SEARCH", s, 6) == 0)
     cmd_parse_search (idata, s);
+  else if (ascii_strncasecmp ("ESEARCH", s, 7) == 0)
+    cmd_parse_esearch (idata, s);
   else if (ascii_strncasecmp ("STATUS", s, 6) == 0)
     cmd_parse_status (idata, s);
   else if (ascii_strncasecmp ("BYE", s, 3) == 0)
@@ -584,26 +592,17 @@ static void cmd_parse_capability (IMAP_DATA* idata, char* s)
  *   be reopened at our earliest convenience */
 static void cmd_parse_expunge (IMAP_DATA* idata, const char* s)
 {
-  int expno, cur;
+  int expno;
   HEADER* h;
 
   dprint (2, (debugfile, "Handling EXPUNGE\n"));
 
   expno = atoi (s);
 
-  /* walk headers, zero seqno of expunged message, decrement seqno of those
-   * above. Possibly we could avoid walking the whole list by resorting
-   * and guessing a good starting point, but I'm guessing the resort would
-   * nullify the gains */
-  for (cur = 0; cur < idata->ctx->msgcount; cur++)
-  {
-    h = idata->ctx->hdrs[cur];
-
-    if (h->index+1 == expno)
-      h->index = -1;
-    else if (h->index+1 > expno)
-      h->index--;
-  }
+  /* zero seqno of expunged message, those above are renumbered when the
+   * response is complete, see imap_msn_compact */
+  if (expno > 0 && (h = imap_msn_remove (idata, expno)))
+    h->index = -1;
 
   idata->reopen |= IMAP_EXPUNGE_PENDING;
 }
@@ -614,28 +613,18 @@ static void cmd_parse_expunge (IMAP_DATA* idata, const char* s)
  *   Of course, a lot of code here duplicates code in message.c. */
 static void cmd_parse_fetch (IMAP_DATA* idata, char* s)
 {
-  int msgno, cur;
+  int msgno;
   HEADER* h = NULL;
 
   dprint (3, (debugfile, "Handling FETCH\n"));
 
   msgno = atoi (s);
-  
-  if (msgno <= idata->ctx->msgcount)
-  /* see cmd_parse_expunge */
-    for (cur = 0; cur < idata->ctx->msgcount; cur++)
-    {
-      h = idata->ctx->hdrs[cur];
-      
-      if (h && h->active && h->index+1 == msgno)
-      {
-	dprint (2, (debugfile, "Message UID %d updated\n", HEADER_DATA(h)->uid));
-	break;
-      }
-      
-      h = NULL;
-    }
-  
+
+  if (msgno > 0 && (h = imap_msn_get (idata, msgno)) && h->active)
+    dprint (2, (debugfile, "Message UID %d updated\n", HEADER_DATA(h)->uid));
+  else
+    h = NULL;
+
   if (!h)
   {
     dprint (3, (debugfile, "FETCH response ignored for this message\n"));
@@ -851,36 +840,94 @@ static void cmd_parse_myrights (IMAP_DATA* idata, const char* s)
   }
 }
 
-/* This should be optimised (eg with a tree or hash) */
-static int uid2msgno (IMAP_DATA* idata, unsigned int uid)
+/* uid2hdr: look up the header of the message with the given UID in the
+ *   selected mailbox */
+static HEADER* uid2hdr (IMAP_DATA* idata, unsigned int uid)
 {
-  int i;
-  
-  for (i = 0; i < idata->ctx->msgcount; i++)
-  {
-    HEADER* h = idata->ctx->hdrs[i];
-    if (HEADER_DATA(h)->uid == uid)
-      return i;
-  }
-  
-  return -1;
+  if (!idata->uid_hash)
+    return NULL;
+
+  return (HEADER*) int_hash_find (idata->uid_hash, uid);
 }
 
 /* cmd_parse_search: store SEARCH response for later use */
 static void cmd_parse_search (IMAP_DATA* idata, const char* s)
 {
-  unsigned int uid;
-  int msgno;
+  HEADER* h;
 
   dprint (2, (debugfile, "Handling SEARCH\n"));
 
   while ((s = imap_next_word ((char*)s)) && *s != '\0')
   {
-    uid = atoi (s);
-    msgno = uid2msgno (idata, uid);
-    
-    if (msgno >= 0)
-      idata->ctx->hdrs[uid2msgno (idata, uid)]->matched = 1;
+    if ((h = uid2hdr (idata, (unsigned int) atoi (s))))
+      h->matched = 1;
+  }
+}
+
+/* cmd_parse_esearch: store the ALL result of an ESEARCH response, a compact
+ *   UID set such as "1:5,7,12:20", like cmd_parse_search does. */
+static void cmd_parse_esearch (IMAP_DATA* idata, const char* s)
+{
+  unsigned long lo, hi, uid;
+  char* end;
+  HEADER* h;
+  int i;
+
+  dprint (2, (debugfile, "Handling ESEARCH\n"));
+
+  s = imap_next_word ((char*)s);
+  /* skip search correlator */
+  if (*s == '(')
+  {
+    if (!(s = strchr (s, ')')))
+      return;
+    s++;
+    SKIPWS (s);
+  }
+  if (!ascii_strncasecmp ("UID", s, 3) && ISSPACE (s[3]))
+    s = imap_next_word ((char*)s);
+
+  /* return data items come in name/value pairs, we only ask for ALL */
+  while (*s && ascii_strncasecmp ("ALL ", s, 4))
+  {
+    s = imap_next_word ((char*)s);
+    s = imap_next_word ((char*)s);
+  }
+  if (!*s)
+    return;
+  s = imap_next_word ((char*)s);
+
+  while (isdigit ((unsigned char) *s))
+  {
+    lo = hi = strtoul (s, &end, 10);
+    if (*end == ':')
+      hi = strtoul (end + 1, &end, 10);
+    if (lo > hi)
+    {
+      uid = lo;
+      lo = hi;
+      hi = uid;
+    }
+
+    /* servers may span gaps of nonexistent UIDs in a range, so don't walk
+     * one that is larger than the mailbox */
+    if (hi - lo >= (unsigned long) idata->ctx->msgcount)
+    {
+      for (i = 0; i < idata->ctx->msgcount; i++)
+      {
+        h = idata->ctx->hdrs[i];
+        if (HEADER_DATA(h)->uid >= lo && HEADER_DATA(h)->uid <= hi)
+          h->matched = 1;
+      }
+    }
+    else
+      for (uid = lo; uid <= hi; uid++)
+        if ((h = uid2hdr (idata, (unsigned int) uid)))
+          h->matched = 1;
+
+    if (*end != ',')
+      break;
+    s = end + 1;
   }
 }
 
@@ -270,6 +270,8 @@ void imap_expunge_mailbox (IMAP_DATA* idata)
 #if USE_HCACHE
       imap_hcache_del (idata, HEADER_DATA(h)->uid);
 #endif
+      if (idata->uid_hash)
+        int_hash_delete (idata->uid_hash, HEADER_DATA(h)->uid, h, NULL);
 
       /* free cached body from disk, if necessary */
       cacheno = HEADER_DATA(h)->uid % IMAP_CACHE_LEN;
@@ -288,6 +290,9 @@ void imap_expunge_mailbox (IMAP_DATA* idata)
   imap_hcache_close (idata);
 #endif
 
+  /* message numbers have shifted, restart the unread prefetch sweep */
+  idata->prefetch_scan = 0;
+
   /* We may be called on to expunge at any time. We can't rely on the caller
    * to always know to rethread */
   mx_update_tables (idata->ctx, 0);
@@ -595,6 +600,7 @@ int imap_open_mailbox (CONTEXT* ctx)
   idata->status = 0;
   memset (idata->ctx->rights, 0, sizeof (idata->ctx->rights));
   idata->newMailCount = 0;
+  idata->prefetch_next = idata->prefetch_left = idata->prefetch_scan = 0;
 
   mutt_message (_("Selecting %s..."), idata->mailbox);
   imap_munge_mbox_name (buf, sizeof(buf), idata->mailbox);
@@ -1345,6 +1351,9 @@ int imap_close_mailbox (CONTEXT* ctx)
     idata->reopen &= IMAP_REOPEN_ALLOW;
     FREE (&(idata->mailbox));
     mutt_free_list (&idata->flags);
+    if (idata->uid_hash)
+      hash_destroy (&idata->uid_hash, NULL);
+    imap_msn_free (idata);
     idata->ctx = NULL;
   }
 
@@ -1775,25 +1784,278 @@ static int imap_compile_search (const pattern_t* pat, BUFFER* buf)
   return 0;
 }
 
+/* how faithfully compile_search reproduces a pattern on the server */
+#define IMAP_SEARCH_NONE     0  /* can't be expressed as a SEARCH */
+#define IMAP_SEARCH_SUPERSET 1  /* server returns at least every match */
+#define IMAP_SEARCH_EXACT    2  /* server returns exactly the matches */
+
+/* search_date: append "KEY DD-Mon-YYYY" to buf */
+static void search_date (BUFFER* buf, const char* key, time_t t)
+{
+  struct tm* tm = localtime (&t);
+
+  mutt_buffer_printf (buf, "%s %02d-%s-%d", key, tm->tm_mday,
+                      Months[tm->tm_mon], tm->tm_year + 1900);
+}
+
+/* compile_leaf: translate a single pattern, ignoring pat->not, into SEARCH
+ *   keys. Keys which are expensive to evaluate locally are counted in
+ *   textkeys. On IMAP_SEARCH_NONE buf may contain garbage. */
+static int compile_leaf (CONTEXT* ctx, const pattern_t* pat, BUFFER* buf,
+                         int* textkeys)
+{
+  char term[STRING];
+  char field[SHORT_STRING];
+  char* delim;
+
+  switch (pat->op)
+  {
+    case M_ALL:
+      mutt_buffer_addstr (buf, "ALL");
+      return IMAP_SEARCH_EXACT;
+
+    /* server flags only agree with ours when nothing is waiting to be
+     * synced */
+    case M_FLAG:
+    case M_READ:
+    case M_UNREAD:
+    case M_REPLIED:
+    case M_DELETED:
+      if (ctx->changed)
+        return IMAP_SEARCH_NONE;
+      mutt_buffer_addstr (buf, pat->op == M_FLAG ? "FLAGGED" :
+                          pat->op == M_READ ? "SEEN" :
+                          pat->op == M_UNREAD ? "UNSEEN" :
+                          pat->op == M_REPLIED ? "ANSWERED" : "DELETED");
+      return IMAP_SEARCH_EXACT;
+
+    /* the server compares dates ignoring time and timezone, so widen the
+     * range by a day on either side */
+    case M_DATE:
+    case M_DATE_RECEIVED:
+      search_date (buf, pat->op == M_DATE ? "SENTSINCE" : "SINCE",
+                   (time_t) pat->min - 24*60*60);
+      mutt_buffer_addch (buf, ' ');
+      search_date (buf, pat->op == M_DATE ? "SENTBEFORE" : "BEFORE",
+                   (time_t) pat->max + 2*24*60*60);
+      return IMAP_SEARCH_SUPERSET;
+
+    /* our size excludes the headers and RFC822.SIZE doesn't, so only the
+     * lower bound carries over */
+    case M_SIZE:
+      if (pat->min <= 0)
+        return IMAP_SEARCH_NONE;
+      mutt_buffer_printf (buf, "LARGER %d", pat->min - 1);
+      return IMAP_SEARCH_SUPERSET;
+
+    default:
+      break;
+  }
+
+  /* the rest are string searches; regexps can't be done on the server */
+  if (!pat->stringmatch)
+    return IMAP_SEARCH_NONE;
+
+  imap_quote_string (term, sizeof (term), pat->p.str);
+
+  switch (pat->op)
+  {
+    case M_BODY:
+      mutt_buffer_printf (buf, "BODY %s", term);
+      break;
+    case M_WHOLE_MSG:
+      mutt_buffer_printf (buf, "TEXT %s", term);
+      break;
+    case M_HEADER:
+      if (!(delim = strchr (pat->p.str, ':')))
+        return IMAP_SEARCH_NONE;
+      *delim = '\0';
+      imap_quote_string (field, sizeof (field), pat->p.str);
+      *delim = ':';
+      delim++;
+      SKIPWS (delim);
+      imap_quote_string (term, sizeof (term), delim);
+      mutt_buffer_printf (buf, "HEADER %s %s", field, term);
+      break;
+
+    /* the server's substring match is case-insensitive */
+    case M_SUBJECT:
+      mutt_buffer_printf (buf, "SUBJECT %s", term);
+      (*textkeys)++;
+      return pat->ign_case ? IMAP_SEARCH_EXACT : IMAP_SEARCH_SUPERSET;
+    case M_ID:
+      mutt_buffer_printf (buf, "HEADER MESSAGE-ID %s", term);
+      (*textkeys)++;
+      return pat->ign_case ? IMAP_SEARCH_EXACT : IMAP_SEARCH_SUPERSET;
+    case M_XLABEL:
+      mutt_buffer_printf (buf, "HEADER X-LABEL %s", term);
+      (*textkeys)++;
+      return pat->ign_case ? IMAP_SEARCH_EXACT : IMAP_SEARCH_SUPERSET;
+
+    /* the server matches the raw header, real names included, so address
+     * searches only ever narrow things down. */
+    case M_FROM:
+    case M_TO:
+    case M_CC:
+    case M_SENDER:
+    case M_RECIPIENT:
+    case M_ADDRESS:
+      if (pat->alladdr)
+        return IMAP_SEARCH_NONE;
+      if (pat->op == M_FROM)
+        mutt_buffer_printf (buf, "FROM %s", term);
+      else if (pat->op == M_TO)
+        mutt_buffer_printf (buf, "TO %s", term);
+      else if (pat->op == M_CC)
+        mutt_buffer_printf (buf, "CC %s", term);
+      else if (pat->op == M_SENDER)
+        mutt_buffer_printf (buf, "HEADER SENDER %s", term);
+      else if (pat->op == M_RECIPIENT)
+        mutt_buffer_printf (buf, "OR TO %s CC %s", term, term);
+      else
+        mutt_buffer_printf (buf, "OR FROM %s OR HEADER SENDER %s OR TO %s CC %s",
+                            term, term, term, term);
+      (*textkeys)++;
+      return IMAP_SEARCH_SUPERSET;
+
+    default:
+      return IMAP_SEARCH_NONE;
+  }
+
+  /* full-text searches are taken as exact, see do_search */
+  (*textkeys)++;
+  return IMAP_SEARCH_EXACT;
+}
+
+/* compile_search: translate a whole pattern tree into SEARCH keys, as far
+ *   as possible. Returns how faithfully buf reproduces the pattern. Clauses
+ *   of an AND that can't be translated are dropped, which leaves a
+ *   superset of the matches. */
+static int compile_search (CONTEXT* ctx, const pattern_t* pat, BUFFER* buf,
+                           int* textkeys)
+{
+  BUFFER keys;
+  BUFFER* clauses = NULL;
+  const pattern_t* clause;
+  int nclauses = 0, n, i;
+  int rc, crc;
+
+  mutt_buffer_init (&keys);
+
+  if (pat->op == M_AND || pat->op == M_OR)
+  {
+    for (clause = pat->child; clause; clause = clause->next)
+      nclauses++;
+    clauses = safe_calloc (nclauses, sizeof (BUFFER));
+
+    rc = IMAP_SEARCH_EXACT;
+    for (clause = pat->child, n = 0; clause; clause = clause->next)
+    {
+      crc = compile_search (ctx, clause, &clauses[n], textkeys);
+      if (crc == IMAP_SEARCH_NONE)
+      {
+        FREE (&clauses[n].data);
+        mutt_buffer_init (&clauses[n]);
+        /* a single unknown alternative may match anything */
+        if (pat->op == M_OR)
+        {
+          rc = IMAP_SEARCH_NONE;
+          break;
+        }
+        rc = IMAP_SEARCH_SUPERSET;
+        continue;
+      }
+      if (crc < rc)
+        rc = crc;
+      n++;
+    }
+    if (!n)
+      rc = IMAP_SEARCH_NONE;
+
+    if (rc != IMAP_SEARCH_NONE)
+    {
+      /* SEARCH keys are implicitly ANDed, OR takes exactly two */
+      for (i = 0; i < n; i++)
+      {
+        if (pat->op == M_OR && i < n - 1)
+          mutt_buffer_addstr (&keys, "OR ");
+        mutt_buffer_printf (&keys, "(%s)%s", clauses[i].data,
+                            i < n - 1 ? " " : "");
+      }
+    }
+
+    for (i = 0; i < nclauses; i++)
+      FREE (&clauses[i].data);
+    FREE (&clauses);
+  }
+  else
+    rc = compile_leaf (ctx, pat, &keys, textkeys);
+
+  /* only an exact translation can be negated */
+  if (pat->not && rc != IMAP_SEARCH_EXACT)
+    rc = IMAP_SEARCH_NONE;
+
+  if (rc != IMAP_SEARCH_NONE)
+  {
+    if (pat->not)
+      mutt_buffer_printf (buf, "NOT (%s)", keys.data);
+    else
+      mutt_buffer_addstr (buf, keys.data);
+  }
+
+  FREE (&keys.data);
+  return rc;
+}
+
+/* imap_search: run as much of a pattern as possible on the server, storing
+ *   the results in h->matched.
+ *   Returns:
+ *     M_IMAP_SEARCH_EXACT      h->matched is the result of the whole pattern
+ *     M_IMAP_SEARCH_CANDIDATES messages without h->matched can't match
+ *     0                        only full-text clauses were searched, see
+ *                              mutt_pattern_exec
+ *    -1                        on error */
 int imap_search (CONTEXT* ctx, const pattern_t* pat)
 {
   BUFFER buf;
   IMAP_DATA* idata = (IMAP_DATA*)ctx->data;
   int i;
+  int textkeys = 0;
+  int rc;
+  /* ask for a compact UID set rather than one UID per message */
+  const char* cmd = mutt_bit_isset (idata->capabilities, ESEARCH) ?
+    "UID SEARCH RETURN (ALL) " : "UID SEARCH ";
 
   for (i = 0; i < ctx->msgcount; i++)
     ctx->hdrs[i]->matched = 0;
 
-  if (!do_search (pat, 1))
-    return 0;
-
   mutt_buffer_init (&buf);
-  mutt_buffer_addstr (&buf, "UID SEARCH ");
-  if (imap_compile_search (pat, &buf) < 0)
+  mutt_buffer_addstr (&buf, cmd);
+
+  /* only worth a round trip if some text has to be searched. A superset of
+   * the matches is only usable if no full-text clause relies on
+   * h->matched being its own result. */
+  rc = compile_search (ctx, pat, &buf, &textkeys);
+  if (textkeys && rc == IMAP_SEARCH_EXACT)
+    rc = M_IMAP_SEARCH_EXACT;
+  else if (textkeys && rc == IMAP_SEARCH_SUPERSET && !do_search (pat, 1))
+    rc = M_IMAP_SEARCH_CANDIDATES;
+  else
   {
     FREE (&buf.data);
-    return -1;
+    rc = 0;
+    if (!do_search (pat, 1))
+      return 0;
+
+    mutt_buffer_init (&buf);
+    mutt_buffer_addstr (&buf, cmd);
+    if (imap_compile_search (pat, &buf) < 0)
+    {
+      FREE (&buf.data);
+      return -1;
+    }
   }
+
   if (imap_exec (idata, buf.data, 0) < 0)
   {
     FREE (&buf.data);
@@ -1801,7 +2063,7 @@ int imap_search (CONTEXT* ctx, const pattern_t* pat)
   }
 
   FREE (&buf.data);
-  return 0;
+  return rc;
 }
 
 int imap_subscribe (char *path, int subscribe)
@@ -31,6 +31,10 @@ typedef struct
   char* mbox;
 } IMAP_MBOX;
 
+/* imap_search results */
+#define M_IMAP_SEARCH_EXACT      1
+#define M_IMAP_SEARCH_CANDIDATES 2
+
 /* imap.c */
 int imap_access (const char*, int);
 int imap_check_mailbox (CONTEXT *ctx, int *index_hint, int force);
@@ -58,6 +62,8 @@ int imap_mailbox_rename (const char* mailbox);
 int imap_append_message (CONTEXT* ctx, MESSAGE* msg);
 int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete);
 int imap_fetch_message (MESSAGE* msg, CONTEXT* ctx, int msgno);
+int imap_prefetch_pending (void);
+int imap_prefetch (void);
 
 /* socket.c */
 void imap_logout_all (void);
@@ -66,6 +72,9 @@ void imap_logout_all (void);
 int imap_expand_path (char* path, size_t len);
 int imap_parse_path (const char* path, IMAP_MBOX* mx);
 void imap_pretty_mailbox (char* path);
+#ifdef USE_HCACHE
+void imap_cache_headers (CONTEXT* ctx);
+#endif
 
 int imap_wait_keepalive (pid_t pid);
 void imap_keepalive (void);
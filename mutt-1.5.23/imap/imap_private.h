@@ -115,6 +115,8 @@ enum
   LOGINDISABLED,		/*           LOGINDISABLED */
   IDLE,                         /* RFC 2177: IDLE */
   SASL_IR,                      /* SASL initial response draft */
+  ESEARCH,                      /* RFC 4731: IMAP4 extension for SEARCH */
+  MOVE,                         /* RFC 6851: IMAP MOVE extension */
 
   CAPMAX
 };
@@ -211,8 +213,19 @@ typedef struct
   IMAP_CACHE cache[IMAP_CACHE_LEN];
   unsigned int uid_validity;
   unsigned int uidnext;
+  HASH *uid_hash;      /* UID -> HEADER of the selected mailbox */
+  HEADER **msn_index;  /* MSN -> HEADER, see imap_msn_get */
+  unsigned int *msn_tree;
+  unsigned int msn_index_size;
+  unsigned int msn_slots;
+  unsigned int max_msn;
   body_cache_t *bcache;
 
+  /* body prefetch state, see imap_prefetch */
+  int prefetch_next;   /* next virtual message number to look at */
+  int prefetch_left;   /* messages still wanted after the one being read */
+  int prefetch_scan;   /* next msgno for the unread sweep */
+
   /* all folder flags - system flags AND keywords */
   LIST *flags;
 #ifdef USE_HCACHE
@@ -276,6 +289,11 @@ int imap_continue (const char* msg, const char* resp);
 void imap_error (const char* where, const char* msg);
 IMAP_DATA* imap_new_idata (void);
 void imap_free_idata (IMAP_DATA** idata);
+void imap_msn_set (IMAP_DATA* idata, unsigned int msn, HEADER* h);
+HEADER* imap_msn_get (IMAP_DATA* idata, unsigned int msn);
+HEADER* imap_msn_remove (IMAP_DATA* idata, unsigned int msn);
+void imap_msn_compact (IMAP_DATA* idata);
+void imap_msn_free (IMAP_DATA* idata);
 char* imap_fix_path (IMAP_DATA* idata, const char* mailbox, char* path, 
   size_t plen);
 void imap_cachepath(IMAP_DATA* idata, const char* mailbox, char* dest,
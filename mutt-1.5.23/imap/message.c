@@ -31,6 +31,7 @@
 #include "mutt.h"
 #include "imap_private.h"
 #include "mx.h"
+#include "mime.h"
 
 #ifdef HAVE_PGP
 #include "pgp.h"
@@ -45,12 +46,19 @@
 static FILE* msg_cache_get (IMAP_DATA* idata, HEADER* h);
 static FILE* msg_cache_put (IMAP_DATA* idata, HEADER* h);
 static int msg_cache_commit (IMAP_DATA* idata, HEADER* h);
+static int msg_prefetch (IMAP_DATA* idata, HEADER* h);
 
 static void flush_buffer(char* buf, size_t* len, CONNECTION* conn);
 static int msg_fetch_header (CONTEXT* ctx, IMAP_HEADER* h, char* buf,
   FILE* fp);
 static int msg_parse_fetch (IMAP_HEADER* h, char* s);
 static char* msg_parse_flags (IMAP_HEADER* h, char* s);
+static void msg_fetch_structure (IMAP_DATA* idata, int first, int last);
+static BODY* msg_parse_structure (char* s);
+static char* msg_structure_body (char* s, BODY** body);
+static int msg_literal_tail (const char* buf, long* bytes);
+static int msg_skip_literal (IMAP_DATA* idata, long bytes);
+static int msg_skip_literals (IMAP_DATA* idata);
 
 /* imap_read_headers:
  * Changed to read many headers instead of just one. It will return the
@@ -70,6 +78,7 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
   int rc, mfhrc, oldmsgcount;
   int fetchlast = 0;
   int maxuid = 0;
+  int wantstruct;
   static const char * const want_headers = "DATE FROM SUBJECT TO CC MESSAGE-ID REFERENCES CONTENT-TYPE CONTENT-DESCRIPTION IN-REPLY-TO REPLY-TO LINES LIST-POST X-LABEL";
   progress_t progress;
   int retval = -1;
@@ -115,6 +124,15 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
   while ((msgend) >= idata->ctx->hdrmax)
     mx_alloc_memory (idata->ctx);
 
+  if (!idata->uid_hash)
+    idata->uid_hash = int_hash_create (MAX (6 * msgend / 5, 30));
+
+  /* attachment counts are taken from the BODYSTRUCTURE, asked for after the
+   * headers so that servers echoing the request order put it on the line
+   * following the header literal */
+  wantstruct = (AttachAllow || AttachExclude || InlineAllow || InlineExclude) &&
+    mutt_bit_isset (idata->capabilities, IMAP4REV1);
+
   oldmsgcount = ctx->msgcount;
   idata->reopen &= ~(IMAP_REOPEN_ALLOW|IMAP_NEWMAIL_PENDING);
   idata->newMailCount = 0;
@@ -199,6 +217,8 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
           ctx->hdrs[idx]->changed = h.data->changed;
           /*  ctx->hdrs[msgno]->received is restored from mutt_hcache_restore */
           ctx->hdrs[idx]->data = (void *) (h.data);
+          int_hash_insert (idata->uid_hash, h.data->uid, ctx->hdrs[idx], 0);
+          imap_msn_set (idata, ctx->hdrs[idx]->index + 1, ctx->hdrs[idx]);
 
           ctx->msgcount++;
           ctx->size += ctx->hdrs[idx]->content->length;
@@ -240,8 +260,9 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
       char *cmd;
 
       fetchlast = msgend + 1;
-      safe_asprintf (&cmd, "FETCH %d:%d (UID FLAGS INTERNALDATE RFC822.SIZE %s)",
-                     msgno + 1, fetchlast, hdrreq);
+      safe_asprintf (&cmd, "FETCH %d:%d (UID FLAGS INTERNALDATE RFC822.SIZE %s%s)",
+                     msgno + 1, fetchlast, hdrreq,
+                     wantstruct ? " BODYSTRUCTURE" : "");
       imap_cmd_start (idata, cmd);
       FREE (&cmd);
     }
@@ -262,6 +283,8 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
       if (rc != IMAP_CMD_CONTINUE)
 	break;
 
+      /* don't carry a structure over from a response that was skipped */
+      mutt_free_body (&h.structure);
       if ((mfhrc = msg_fetch_header (ctx, &h, idata->buf, fp)) == -1)
 	continue;
       else if (mfhrc < 0)
@@ -310,6 +333,8 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
       ctx->hdrs[idx]->changed = h.data->changed;
       ctx->hdrs[idx]->received = h.received;
       ctx->hdrs[idx]->data = (void *) (h.data);
+      int_hash_insert (idata->uid_hash, h.data->uid, ctx->hdrs[idx], 0);
+      imap_msn_set (idata, h.sid, ctx->hdrs[idx]);
 
       if (maxuid < h.data->uid)
         maxuid = h.data->uid;
@@ -322,6 +347,11 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
       /* content built as a side-effect of mutt_read_rfc822_header */
       ctx->hdrs[idx]->content->length = h.content_length;
       ctx->size += h.content_length;
+      if (h.structure)
+      {
+        mutt_set_attach_count (ctx->hdrs[idx], h.structure);
+        mutt_free_body (&h.structure);
+      }
 
 #if USE_HCACHE
       imap_hcache_put (idata, ctx->hdrs[idx]);
@@ -332,6 +362,8 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
     while ((rc != IMAP_CMD_OK) && ((mfhrc == -1) ||
       ((msgno + 1) >= fetchlast)));
 
+    mutt_free_body (&h.structure);
+
     if ((mfhrc < -1) || ((rc != IMAP_CMD_CONTINUE) && (rc != IMAP_CMD_OK)))
     {
       imap_free_header_data (&h.data);
@@ -352,6 +384,8 @@ int imap_read_headers (IMAP_DATA* idata, int msgbegin, int msgend)
     }
   }
 
+  msg_fetch_structure (idata, oldmsgcount, ctx->msgcount);
+
   if (maxuid && (status = imap_mboxcache_get (idata, idata->mailbox, 0)))
   status->uidnext = maxuid + 1;
 
@@ -411,6 +445,13 @@ int imap_fetch_message (MESSAGE *msg, CONTEXT *ctx, int msgno)
   idata = (IMAP_DATA*) ctx->data;
   h = ctx->hdrs[msgno];
 
+  /* prefetch what the user is likely to read next */
+  if (h->virtual >= 0)
+  {
+    idata->prefetch_next = h->virtual + 1;
+    idata->prefetch_left = ImapPrefetch;
+  }
+
   if ((msg->fp = msg_cache_get (idata, h)))
   {
     if (HEADER_DATA(h)->parsed)
@@ -739,6 +780,8 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
   IMAP_MBOX mx;
   int err_continue = M_NO;
   int triedcreate = 0;
+  int move, reopen;
+  const char* verb;
 
   idata = (IMAP_DATA*) ctx->data;
 
@@ -767,6 +810,17 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
     strfcpy (mbox, "INBOX", sizeof (mbox));
   imap_munge_mbox_name (mmbox, sizeof (mmbox), mbox);
 
+  /* with MOVE the server expunges the source messages itself, so there is
+   * nothing left to purge later. Its EXPUNGE responses are deliberately not
+   * marked IMAP_EXPUNGE_EXPECTED: the next check must report M_REOPENED so
+   * the index and pager drop the headers before they are freed. */
+  move = delete && mutt_bit_isset (idata->capabilities, MOVE);
+  verb = move ? "UID MOVE" : "UID COPY";
+
+  /* the EXPUNGE responses to MOVE must not free h under us */
+  reopen = idata->reopen & IMAP_REOPEN_ALLOW;
+  idata->reopen &= ~IMAP_REOPEN_ALLOW;
+
   /* loop in case of TRYCREATE */
   do
   {
@@ -784,7 +838,8 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
         if (ctx->hdrs[n]->tagged && ctx->hdrs[n]->attach_del)
         {
           dprint (3, (debugfile, "imap_copy_messages: Message contains attachments to be deleted\n"));
-          return 1;
+          rc = 1;
+          goto out;
         }
 
         if (ctx->hdrs[n]->tagged && ctx->hdrs[n]->active &&
@@ -799,7 +854,7 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
         }
       }
 
-      rc = imap_exec_msgset (idata, "UID COPY", mmbox, M_TAG, 0, 0);
+      rc = imap_exec_msgset (idata, verb, mmbox, M_TAG, 0, 0);
       if (!rc)
       {
         dprint (1, (debugfile, "imap_copy_messages: No messages tagged\n"));
@@ -811,13 +866,18 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
         dprint (1, (debugfile, "could not queue copy\n"));
         goto out;
       }
+      else if (move)
+        mutt_message (_("Moving %d messages to %s..."), rc, mbox);
       else
         mutt_message (_("Copying %d messages to %s..."), rc, mbox);
     }
     else
     {
-      mutt_message (_("Copying message %d to %s..."), h->index+1, mbox);
-      mutt_buffer_printf (&cmd, "UID COPY %u %s", HEADER_DATA (h)->uid, mmbox);
+      if (move)
+        mutt_message (_("Moving message %d to %s..."), h->index+1, mbox);
+      else
+        mutt_message (_("Copying message %d to %s..."), h->index+1, mbox);
+      mutt_buffer_printf (&cmd, "%s %u %s", verb, HEADER_DATA (h)->uid, mmbox);
 
       if (h->active && h->changed)
       {
@@ -891,6 +951,7 @@ int imap_copy_messages (CONTEXT* ctx, HEADER* h, char* dest, int delete)
   rc = 0;
 
  out:
+  idata->reopen |= reopen;
   if (cmd.data)
     FREE (&cmd.data);
   if (sync_cmd.data)
@@ -963,7 +1024,7 @@ int imap_cache_del (IMAP_DATA* idata, HEADER* h)
 
 static int msg_cache_clean_cb (const char* id, body_cache_t* bcache, void* data)
 {
-  unsigned int uv, uid, n;
+  unsigned int uv, uid;
   IMAP_DATA* idata = (IMAP_DATA*)data;
 
   if (sscanf (id, "%u-%u", &uv, &uid) != 2)
@@ -973,12 +1034,8 @@ static int msg_cache_clean_cb (const char* id, body_cache_t* bcache, void* data)
   if (uv != idata->uid_validity)
     mutt_bcache_del (bcache, id);
 
-  /* TODO: presort UIDs, walk in order */
-  for (n = 0; n < idata->ctx->msgcount; n++)
-  {
-    if (uid == HEADER_DATA(idata->ctx->hdrs[n])->uid)
-      return 0;
-  }
+  if (idata->uid_hash && int_hash_find (idata->uid_hash, uid))
+    return 0;
   mutt_bcache_del (bcache, id);
 
   return 0;
@@ -992,6 +1049,186 @@ int imap_cache_clean (IMAP_DATA* idata)
   return 0;
 }
 
+/* prefetch_idata: the connection of the current folder, if it is an IMAP
+ *   folder with a body cache we may prefetch into */
+static IMAP_DATA* prefetch_idata (void)
+{
+  IMAP_DATA* idata;
+
+  if (!Context || Context->magic != M_IMAP || !MessageCachedir)
+    return NULL;
+
+  idata = (IMAP_DATA*) Context->data;
+  if (!idata || idata->ctx != Context || idata->state < IMAP_SELECTED ||
+      idata->status == IMAP_FATAL ||
+      !mutt_bit_isset (idata->capabilities, IMAP4REV1))
+    return NULL;
+
+  return idata;
+}
+
+/* imap_prefetch_pending: returns 1 if imap_prefetch may have work to do */
+int imap_prefetch_pending (void)
+{
+  IMAP_DATA* idata;
+
+  if (!ImapPrefetch && !ImapPrefetchUnread)
+    return 0;
+  if (!(idata = prefetch_idata ()))
+    return 0;
+
+  return (idata->prefetch_left > 0 &&
+          idata->prefetch_next < idata->ctx->vcount) ||
+    (ImapPrefetchUnread > 0 && idata->prefetch_scan < idata->ctx->msgcount);
+}
+
+/* imap_prefetch: fetch at most one message body ahead of the reader into
+ *   the body cache. Candidates are the $imap_prefetch messages following
+ *   the last one opened, then unread messages no larger than
+ *   $imap_prefetch_unread kilobytes. Meant to be called repeatedly while
+ *   the user is idle, so each call does a single round trip.
+ *   Returns 1 if a message was fetched, 0 if there was nothing left to do
+ *   and -1 on error. */
+int imap_prefetch (void)
+{
+  IMAP_DATA* idata;
+  CONTEXT* ctx;
+  HEADER* h;
+
+  if (!(idata = prefetch_idata ()))
+    return 0;
+  ctx = idata->ctx;
+
+  if (!(idata->bcache = msg_cache_open (idata)))
+    return 0;
+
+  while (idata->prefetch_left > 0 && idata->prefetch_next < ctx->vcount)
+  {
+    h = ctx->hdrs[ctx->v2r[idata->prefetch_next++]];
+    idata->prefetch_left--;
+
+    if (h->active && !h->deleted)
+      switch (msg_prefetch (idata, h))
+      {
+        case 0:
+          continue;
+        case 1:
+          return 1;
+        default:
+          idata->prefetch_left = 0;
+          return -1;
+      }
+  }
+
+  while (ImapPrefetchUnread > 0 && idata->prefetch_scan < ctx->msgcount)
+  {
+    h = ctx->hdrs[idata->prefetch_scan++];
+
+    if (h->active && !h->read && !h->deleted &&
+        h->content->length <= ImapPrefetchUnread * 1024L)
+      switch (msg_prefetch (idata, h))
+      {
+        case 0:
+          continue;
+        case 1:
+          return 1;
+        default:
+          idata->prefetch_scan = ctx->msgcount;
+          return -1;
+      }
+  }
+
+  return 0;
+}
+
+/* msg_prefetch: download the body of h into the body cache unless it is
+ *   already there. The message is fetched with BODY.PEEK so its \Seen flag
+ *   is left alone.
+ *   Returns 1 if the message was fetched, 0 if it was already cached and
+ *   -1 on failure. */
+static int msg_prefetch (IMAP_DATA* idata, HEADER* h)
+{
+  char id[_POSIX_PATH_MAX];
+  char buf[SHORT_STRING];
+  FILE* fp;
+  char* pc;
+  long bytes;
+  unsigned char reopen;
+  int fetched = 0;
+  int rc;
+
+  snprintf (id, sizeof (id), "%u-%u", idata->uid_validity, HEADER_DATA(h)->uid);
+  if (!mutt_bcache_exists (idata->bcache, id))
+    return 0;
+
+  if (!(fp = msg_cache_put (idata, h)))
+    return -1;
+
+  dprint (2, (debugfile, "msg_prefetch: fetching UID %u\n", HEADER_DATA(h)->uid));
+
+  /* the folder must not be reopened or expunged underneath us while we
+   * are working in the background; that will be picked up by the next
+   * imap_check_mailbox instead. See also imap_fetch_message for why the
+   * header is marked inactive. */
+  reopen = idata->reopen & IMAP_REOPEN_ALLOW;
+  idata->reopen &= ~IMAP_REOPEN_ALLOW;
+  h->active = 0;
+
+  snprintf (buf, sizeof (buf), "UID FETCH %u BODY.PEEK[]", HEADER_DATA(h)->uid);
+  imap_cmd_start (idata, buf);
+  do
+  {
+    if ((rc = imap_cmd_step (idata)) != IMAP_CMD_CONTINUE)
+      break;
+
+    pc = imap_next_word (idata->buf);
+    pc = imap_next_word (pc);
+    if (ascii_strncasecmp ("FETCH", pc, 5))
+      continue;
+
+    while (*pc)
+    {
+      pc = imap_next_word (pc);
+      if (pc[0] == '(')
+        pc++;
+      if (!ascii_strncasecmp ("BODY[]", pc, 6))
+      {
+        pc = imap_next_word (pc);
+        if (imap_get_literal_count (pc, &bytes) < 0 ||
+            imap_read_literal (fp, idata, bytes, NULL) < 0)
+        {
+          rc = IMAP_CMD_BAD;
+          break;
+        }
+        /* pick up trailing line */
+        if ((rc = imap_cmd_step (idata)) != IMAP_CMD_CONTINUE)
+          break;
+        pc = idata->buf;
+        fetched = 1;
+      }
+    }
+  }
+  while (rc == IMAP_CMD_CONTINUE);
+
+  h->active = 1;
+  idata->reopen |= reopen;
+
+  if (fflush (fp) || ferror (fp))
+    fetched = 0;
+  safe_fclose (&fp);
+
+  if (rc == IMAP_CMD_OK && fetched && imap_code (idata->buf) &&
+      !msg_cache_commit (idata, h))
+    return 1;
+
+  dprint (1, (debugfile, "msg_prefetch: could not fetch UID %u\n",
+              HEADER_DATA(h)->uid));
+  safe_strcat (id, sizeof (id), ".tmp");
+  mutt_bcache_del (idata->bcache, id);
+
+  return -1;
+}
+
 /* imap_add_keywords: concatenate custom IMAP tags to list, if they
  *   appear in the folder flags list. Why wouldn't they? */
 void imap_add_keywords (char* s, HEADER* h, LIST* mailbox_flags, size_t slen)
@@ -1100,7 +1337,11 @@ static int msg_fetch_header (CONTEXT* ctx, IMAP_HEADER* h, char* buf, FILE* fp)
   /* FIXME: current implementation - call msg_parse_fetch - if it returns -2,
    *   read header lines and call it again. Silly. */
   if ((rc = msg_parse_fetch (h, buf)) != -2 || !fp)
+  {
+    if (!rc && fp)
+      msg_skip_literals (idata);
     return rc;
+  }
 
   if (imap_get_literal_count (buf, &bytes) == 0)
   {
@@ -1115,6 +1356,9 @@ static int msg_fetch_header (CONTEXT* ctx, IMAP_HEADER* h, char* buf, FILE* fp)
 
     if (msg_parse_fetch (h, idata->buf) == -1)
       return rc;
+
+    if (msg_skip_literals (idata) < 0)
+      return rc;
   }
 
   rc = 0; /* success */
@@ -1181,6 +1425,17 @@ static int msg_parse_fetch (IMAP_HEADER *h, char *s)
       *ptmp = 0;
       h->content_length = atoi (tmp);
     }
+    else if (ascii_strncasecmp ("BODYSTRUCTURE", s, 13) == 0)
+    {
+      mutt_free_body (&h->structure);
+      if ((ptmp = msg_structure_body (s + 13, &h->structure)))
+        s = ptmp;
+      else
+      {
+        mutt_free_body (&h->structure);
+        return 0;
+      }
+    }
     else if (!ascii_strncasecmp ("BODY", s, 4) ||
       !ascii_strncasecmp ("RFC822.HEADER", s, 13))
     {
@@ -1200,6 +1455,336 @@ static int msg_parse_fetch (IMAP_HEADER *h, char *s)
   return 0;
 }
 
+/* msg_structure_string: read an atom, quoted string or NIL into buf.
+ *   Literals are not handled; NULL is returned for them and on errors. */
+static char* msg_structure_string (char* s, char* buf, size_t buflen)
+{
+  size_t n = 0;
+
+  SKIPWS (s);
+  if (*s == '"')
+  {
+    s++;
+    while (*s && *s != '"')
+    {
+      if (*s == '\\' && s[1])
+        s++;
+      if (n + 1 < buflen)
+        buf[n++] = *s;
+      s++;
+    }
+    if (*s != '"')
+      return NULL;
+    s++;
+  }
+  else if (!*s || *s == '{' || *s == '(' || *s == ')')
+    return NULL;
+  else
+  {
+    while (*s && !ISSPACE (*s) && *s != '(' && *s != ')')
+    {
+      if (n + 1 < buflen)
+        buf[n++] = *s;
+      s++;
+    }
+    if (n == 3 && !ascii_strncasecmp (buf, "NIL", 3))
+      n = 0;
+  }
+  buf[n] = 0;
+
+  return s;
+}
+
+/* msg_structure_skip: skip one item, which may be a parenthesised list */
+static char* msg_structure_skip (char* s)
+{
+  char tmp[SHORT_STRING];
+
+  SKIPWS (s);
+  if (*s != '(')
+    return msg_structure_string (s, tmp, sizeof (tmp));
+
+  s++;
+  SKIPWS (s);
+  while (*s && *s != ')')
+  {
+    if (!(s = msg_structure_skip (s)))
+      return NULL;
+    SKIPWS (s);
+  }
+  if (*s != ')')
+    return NULL;
+
+  return s + 1;
+}
+
+/* msg_structure_end: skip the remaining extension data of a body */
+static char* msg_structure_end (char* s)
+{
+  SKIPWS (s);
+  while (*s && *s != ')')
+  {
+    if (!(s = msg_structure_skip (s)))
+      return NULL;
+    SKIPWS (s);
+  }
+  if (*s != ')')
+    return NULL;
+
+  return s + 1;
+}
+
+/* msg_structure_disposition: read a body-fld-dsp, as
+ *   parse_content_disposition does for a Content-Disposition header */
+static char* msg_structure_disposition (char* s, BODY* b)
+{
+  char tmp[SHORT_STRING];
+
+  SKIPWS (s);
+  if (*s != '(')
+    return msg_structure_string (s, tmp, sizeof (tmp));
+
+  if (!(s = msg_structure_string (s + 1, tmp, sizeof (tmp))))
+    return NULL;
+  if (!ascii_strcasecmp ("inline", tmp))
+    b->disposition = DISPINLINE;
+  else if (!ascii_strcasecmp ("form-data", tmp))
+    b->disposition = DISPFORMDATA;
+  else
+    b->disposition = DISPATTACH;
+
+  /* parameters */
+  return msg_structure_end (s);
+}
+
+/* msg_structure_body: build the BODY tree of a BODYSTRUCTURE. Only the
+ *   fields needed to count attachments are filled in; offsets are not
+ *   known, so the tree cannot be used to display the message. */
+static char* msg_structure_body (char* s, BODY** body)
+{
+  char tmp[SHORT_STRING];
+  BODY* b;
+  BODY** last;
+  int i;
+
+  SKIPWS (s);
+  if (*s != '(')
+    return NULL;
+  s++;
+  SKIPWS (s);
+
+  b = *body = mutt_new_body ();
+  b->disposition = DISPINLINE;
+
+  if (*s == '(')
+  {
+    b->type = TYPEMULTIPART;
+    for (last = &b->parts; *s == '('; last = &(*last)->next)
+    {
+      if (!(s = msg_structure_body (s, last)))
+        return NULL;
+      SKIPWS (s);
+    }
+    if (!(s = msg_structure_string (s, tmp, sizeof (tmp))))
+      return NULL;
+    b->subtype = safe_strdup (tmp);
+
+    /* parameters, then the disposition */
+    SKIPWS (s);
+    if (*s && *s != ')')
+    {
+      if (!(s = msg_structure_skip (s)))
+        return NULL;
+      SKIPWS (s);
+      if (*s && *s != ')' && !(s = msg_structure_disposition (s, b)))
+        return NULL;
+    }
+
+    return msg_structure_end (s);
+  }
+
+  if (!(s = msg_structure_string (s, tmp, sizeof (tmp))))
+    return NULL;
+  b->type = mutt_check_mime_type (tmp);
+  if (b->type == TYPEOTHER)
+    b->xtype = safe_strdup (tmp);
+  if (!(s = msg_structure_string (s, tmp, sizeof (tmp))))
+    return NULL;
+  b->subtype = safe_strdup (tmp);
+
+  /* parameters, id, description, encoding and size */
+  for (i = 0; i < 5; i++)
+    if (!(s = msg_structure_skip (s)))
+      return NULL;
+
+  if (b->type == TYPEMESSAGE && !ascii_strcasecmp ("rfc822", b->subtype))
+  {
+    /* envelope, the encapsulated body and its lines */
+    if (!(s = msg_structure_skip (s)) ||
+        !(s = msg_structure_body (s, &b->parts)) ||
+        !(s = msg_structure_skip (s)))
+      return NULL;
+  }
+  else if (b->type == TYPETEXT)
+  {
+    if (!(s = msg_structure_skip (s)))
+      return NULL;
+  }
+
+  /* MD5, then the disposition */
+  SKIPWS (s);
+  if (*s && *s != ')')
+  {
+    if (!(s = msg_structure_skip (s)))
+      return NULL;
+    SKIPWS (s);
+    if (*s && *s != ')' && !(s = msg_structure_disposition (s, b)))
+      return NULL;
+  }
+
+  return msg_structure_end (s);
+}
+
+/* msg_parse_structure: find and build the BODYSTRUCTURE in the data of a
+ *   FETCH response, or return NULL if it is missing or can't be parsed */
+static BODY* msg_parse_structure (char* s)
+{
+  char tmp[SHORT_STRING];
+  BODY* b = NULL;
+
+  while (s)
+  {
+    SKIPWS (s);
+    if (!*s || *s == ')')
+      break;
+    if (!(s = msg_structure_string (s, tmp, sizeof (tmp))))
+      break;
+    if (!ascii_strcasecmp ("BODYSTRUCTURE", tmp))
+    {
+      if (!msg_structure_body (s, &b))
+        mutt_free_body (&b);
+      break;
+    }
+    s = msg_structure_skip (s);
+  }
+
+  return b;
+}
+
+/* msg_literal_tail: is the line followed by a literal? */
+static int msg_literal_tail (const char* buf, long* bytes)
+{
+  const char* p = buf + mutt_strlen (buf);
+
+  if (p == buf || *--p != '}')
+    return -1;
+  while (p > buf && isdigit ((unsigned char) p[-1]))
+    p--;
+  if (p == buf || p[-1] != '{')
+    return -1;
+  *bytes = atol (p);
+
+  return 0;
+}
+
+/* msg_skip_literal: read and discard a literal */
+static int msg_skip_literal (IMAP_DATA* idata, long bytes)
+{
+  char c;
+
+  for (; bytes > 0; bytes--)
+    if (mutt_socket_readchar (idata->conn, &c) != 1)
+    {
+      idata->status = IMAP_FATAL;
+      return -1;
+    }
+
+  return 0;
+}
+
+/* msg_skip_literals: a BODYSTRUCTURE containing literals isn't parsed by
+ *   msg_parse_fetch, which leaves the message to msg_fetch_structure. Throw
+ *   away the literals ending idata->buf and the lines following them. */
+static int msg_skip_literals (IMAP_DATA* idata)
+{
+  long bytes;
+
+  while (!msg_literal_tail (idata->buf, &bytes))
+    if (msg_skip_literal (idata, bytes) < 0 ||
+        imap_cmd_step (idata) != IMAP_CMD_CONTINUE)
+      return -1;
+
+  return 0;
+}
+
+/* msg_fetch_structure: count the attachments of the headers in
+ *   [first, last) that are still without a count from their BODYSTRUCTURE,
+ *   so that %X and ~X don't have to download every message. New headers
+ *   normally get theirs from the header FETCH; this covers those restored
+ *   from an older header cache and structures the header FETCH couldn't
+ *   parse, and sends nothing when there are none. */
+static void msg_fetch_structure (IMAP_DATA* idata, int first, int last)
+{
+  CONTEXT* ctx = idata->ctx;
+  HEADER* h;
+  BODY* b;
+  char* cmd;
+  char* s;
+  long bytes;
+  int lo = 0, hi = 0;
+  int i, rc;
+
+  if (!(AttachAllow || AttachExclude || InlineAllow || InlineExclude) ||
+      !mutt_bit_isset (idata->capabilities, IMAP4REV1))
+    return;
+
+  for (i = first; i < last; i++)
+  {
+    if (ctx->hdrs[i]->attach_valid)
+      continue;
+    if (!lo || ctx->hdrs[i]->index + 1 < lo)
+      lo = ctx->hdrs[i]->index + 1;
+    if (ctx->hdrs[i]->index + 1 > hi)
+      hi = ctx->hdrs[i]->index + 1;
+  }
+  if (!lo)
+    return;
+
+  safe_asprintf (&cmd, "FETCH %d:%d (UID BODYSTRUCTURE)", lo, hi);
+  imap_cmd_start (idata, cmd);
+  FREE (&cmd);
+
+  while ((rc = imap_cmd_step (idata)) == IMAP_CMD_CONTINUE)
+  {
+    s = idata->buf;
+    if (!ascii_strncmp ("* ", s, 2) && (h = imap_msn_get (idata, atoi (s + 2))) &&
+        !h->attach_valid && !ascii_strncasecmp ("FETCH", imap_next_word (s + 2), 5) &&
+        (s = strchr (s, '(')) && (b = msg_parse_structure (s + 1)))
+    {
+      mutt_set_attach_count (h, b);
+      mutt_free_body (&b);
+#if USE_HCACHE
+      imap_hcache_put (idata, h);
+#endif
+    }
+
+    /* a structure containing literals is skipped; the message will be
+     * counted the usual way */
+    while (!msg_literal_tail (idata->buf, &bytes))
+    {
+      if (msg_skip_literal (idata, bytes) < 0)
+        return;
+      if ((rc = imap_cmd_step (idata)) != IMAP_CMD_CONTINUE)
+        break;
+    }
+    if (rc != IMAP_CMD_CONTINUE)
+      break;
+  }
+
+  if (rc != IMAP_CMD_OK)
+    dprint (1, (debugfile, "msg_fetch_structure: BODYSTRUCTURE fetch failed\n"));
+}
+
 /* msg_parse_flags: read a FLAGS token into an IMAP_HEADER */
 static char* msg_parse_flags (IMAP_HEADER* h, char* s)
 {
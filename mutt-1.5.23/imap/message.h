@@ -48,6 +48,7 @@ typedef struct
 
   time_t received;
   long content_length;
+  BODY* structure;	/* from BODYSTRUCTURE, if it was fetched */
 } IMAP_HEADER;
 
 /* -- macros -- */
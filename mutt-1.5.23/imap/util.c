@@ -158,6 +158,34 @@ int imap_hcache_del (IMAP_DATA* idata, unsigned int uid)
   sprintf (key, "/%u", uid);
   return mutt_hcache_delete (idata->hcache, key, imap_hcache_keylen);
 }
+
+/* store the headers queued by mx_cache_header, opening the cache at most
+ *   once */
+void imap_cache_headers (CONTEXT* ctx)
+{
+  IMAP_DATA* idata = (IMAP_DATA*) ctx->data;
+  HEADER* h;
+  int i, opened = 0;
+
+  if (idata && !idata->hcache)
+  {
+    idata->hcache = imap_hcache_open (idata, NULL);
+    opened = 1;
+  }
+
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    h = ctx->hdrs[i];
+    if (!h->hcache_dirty)
+      continue;
+    h->hcache_dirty = 0;
+    if (idata && idata->hcache && HEADER_DATA (h))
+      imap_hcache_put (idata, h);
+  }
+
+  if (opened)
+    imap_hcache_close (idata);
+}
 #endif
 
 /* imap_parse_path: given an IMAP mailbox name, return host, port
@@ -398,10 +426,171 @@ void imap_free_idata (IMAP_DATA** idata)
   mutt_buffer_free(&(*idata)->cmdbuf);
   FREE (&(*idata)->buf);
   mutt_bcache_close (&(*idata)->bcache);
+  if ((*idata)->uid_hash)
+    hash_destroy (&(*idata)->uid_hash, NULL);
+  imap_msn_free (*idata);
   FREE (&(*idata)->cmds);
   FREE (idata);		/* __FREE_CHECKED__ */
 }
 
+/* The MSN index is kept by slot. A message gets the next free slot when it
+ *   is first seen and an EXPUNGE only frees its slot, so that a burst of
+ *   EXPUNGE responses does not renumber the whole table each time.
+ *   msn_tree is a Fenwick tree counting the slots in use, which turns an
+ *   MSN into its slot in O(log n). imap_msn_compact squeezes out the freed
+ *   slots and renumbers the headers once the server response is done. */
+
+static void msn_tree_build (unsigned int* tree, unsigned int n)
+{
+  unsigned int i, j;
+
+  for (i = 1; i <= n; i++)
+    if ((j = i + (i & -i)) <= n)
+      tree[j] += tree[i];
+}
+
+/* msn_tree_unbuild: inverse of msn_tree_build, leaves the count of each
+ *   single slot in tree[slot] */
+static void msn_tree_unbuild (unsigned int* tree, unsigned int n)
+{
+  unsigned int i, j;
+
+  for (i = n; i >= 1; i--)
+    if ((j = i + (i & -i)) <= n)
+      tree[j] -= tree[i];
+}
+
+static void msn_tree_add (IMAP_DATA* idata, unsigned int slot, int delta)
+{
+  for (; slot <= idata->msn_index_size; slot += slot & -slot)
+    idata->msn_tree[slot] += delta;
+}
+
+/* msn_slot: return the slot holding msn, which must be 1..max_msn */
+static unsigned int msn_slot (IMAP_DATA* idata, unsigned int msn)
+{
+  unsigned int slot = 0, step;
+
+  if (idata->msn_slots == idata->max_msn)
+    return msn;
+
+  for (step = 1; step * 2 <= idata->msn_index_size; step *= 2)
+    ;
+  for (; step; step /= 2)
+    if (slot + step <= idata->msn_index_size &&
+        idata->msn_tree[slot + step] < msn)
+    {
+      slot += step;
+      msn -= idata->msn_tree[slot];
+    }
+
+  return slot + 1;
+}
+
+/* imap_msn_set: record h as the message with sequence number msn in the
+ *   selected mailbox, growing the index as needed. */
+void imap_msn_set (IMAP_DATA* idata, unsigned int msn, HEADER* h)
+{
+  unsigned int slot, oldsize, newsize;
+
+  if (!msn)
+    return;
+
+  if (msn <= idata->max_msn)
+  {
+    idata->msn_index[msn_slot (idata, msn) - 1] = h;
+    return;
+  }
+
+  slot = idata->msn_slots + msn - idata->max_msn;
+  if (slot > idata->msn_index_size)
+  {
+    oldsize = idata->msn_index_size;
+    newsize = MAX (slot, 2 * oldsize);
+    newsize = MAX (newsize, 64);
+    safe_realloc (&idata->msn_index, newsize * sizeof (HEADER*));
+    memset (idata->msn_index + oldsize, 0, (newsize - oldsize) * sizeof (HEADER*));
+    safe_realloc (&idata->msn_tree, (newsize + 1) * sizeof (unsigned int));
+    if (oldsize)
+      msn_tree_unbuild (idata->msn_tree, oldsize);
+    memset (idata->msn_tree + oldsize + 1, 0,
+            (newsize - oldsize) * sizeof (unsigned int));
+    idata->msn_index_size = newsize;
+    msn_tree_build (idata->msn_tree, newsize);
+  }
+
+  while (idata->msn_slots < slot)
+    msn_tree_add (idata, ++idata->msn_slots, 1);
+  idata->msn_index[slot - 1] = h;
+  idata->max_msn = msn;
+}
+
+/* imap_msn_get: return the header with sequence number msn, or NULL */
+HEADER* imap_msn_get (IMAP_DATA* idata, unsigned int msn)
+{
+  if (!msn || msn > idata->max_msn)
+    return NULL;
+
+  return idata->msn_index[msn_slot (idata, msn) - 1];
+}
+
+/* imap_msn_remove: handle EXPUNGE of msn. Every message above it moves
+ *   down one, as on the server, though their HEADER index is only updated
+ *   by imap_msn_compact. Returns the expunged header, or NULL if it was
+ *   not known. */
+HEADER* imap_msn_remove (IMAP_DATA* idata, unsigned int msn)
+{
+  HEADER* h;
+  unsigned int slot;
+
+  if (!msn || msn > idata->max_msn)
+    return NULL;
+
+  slot = msn_slot (idata, msn);
+  h = idata->msn_index[slot - 1];
+  idata->msn_index[slot - 1] = NULL;
+  msn_tree_add (idata, slot, -1);
+  idata->max_msn--;
+
+  return h;
+}
+
+/* imap_msn_compact: drop the slots freed by imap_msn_remove and bring the
+ *   HEADER index of the remaining messages up to date, in one pass. */
+void imap_msn_compact (IMAP_DATA* idata)
+{
+  unsigned int i, n = 0;
+
+  if (idata->msn_slots == idata->max_msn)
+    return;
+
+  msn_tree_unbuild (idata->msn_tree, idata->msn_index_size);
+  for (i = 1; i <= idata->msn_slots; i++)
+  {
+    if (!idata->msn_tree[i])
+      continue;
+    idata->msn_index[n] = idata->msn_index[i - 1];
+    if (idata->msn_index[n])
+      idata->msn_index[n]->index = n;
+    n++;
+  }
+  memset (idata->msn_index + n, 0, (idata->msn_slots - n) * sizeof (HEADER*));
+
+  for (i = 1; i <= idata->msn_index_size; i++)
+    idata->msn_tree[i] = i <= n;
+  msn_tree_build (idata->msn_tree, idata->msn_index_size);
+  idata->msn_slots = n;
+}
+
+void imap_msn_free (IMAP_DATA* idata)
+{
+  FREE (&idata->msn_index);
+  FREE (&idata->msn_tree);
+  idata->msn_index_size = 0;
+  idata->msn_slots = 0;
+  idata->max_msn = 0;
+}
+
 /*
  * Fix up the imap path.  This is necessary because the rest of mutt
  * assumes a hierarchy delimiter of '/', which is not necessarily true
@@ -121,16 +121,44 @@ int query_quadoption (int opt, const char *prompt)
 }
 
 
+/* variables and commands by name, filled in on first use */
+static HASH *OptionHash = NULL;
+static HASH *CommandHash = NULL;
+
 /* given the variable ``s'', return the index into the rc_vars array which
    matches, or -1 if the variable is not found.  */
 static int mutt_option_index (char *s)
 {
+        struct option_t *opt;
         int i;
 
-        for (i = 0; MuttVars[i].option; i++)
-                if (mutt_strcmp (s, MuttVars[i].option) == 0)
-                        return (MuttVars[i].type == DT_SYN ?  mutt_option_index ((char *) MuttVars[i].data) : i);
-        return (-1);
+        if (!OptionHash) {
+                OptionHash = hash_create (1031, 0);
+                for (i = 0; MuttVars[i].option; i++)
+                        hash_insert (OptionHash, MuttVars[i].option, &MuttVars[i], 0);
+        }
+
+        if (!s || !(opt = hash_find (OptionHash, s)))
+                return (-1);
+        return (opt->type == DT_SYN ?  mutt_option_index ((char *) opt->data) : opt - MuttVars);
+}
+
+
+/* return the index into Commands of the command called ``s'', or -1 */
+static int mutt_command_index (const char *s)
+{
+        const struct command_t *cmd;
+        int i;
+
+        if (!CommandHash) {
+                CommandHash = hash_create (257, 0);
+                for (i = 0; Commands[i].name; i++)
+                        hash_insert (CommandHash, Commands[i].name, (void *) &Commands[i], 0);
+        }
+
+        if (!s || !(cmd = hash_find (CommandHash, s)))
+                return (-1);
+        return (cmd - Commands);
 }
 
 
@@ -391,7 +419,6 @@ static void add_to_list (LIST **list, const char *str)
 
 int mutt_add_to_rx_list (RX_LIST **list, const char *s, int flags, BUFFER *err)
 {
-        RX_LIST *t, *last = NULL;
         REGEXP *rx;
 
         if (!s || !*s)
@@ -403,28 +430,8 @@ int mutt_add_to_rx_list (RX_LIST **list, const char *s, int flags, BUFFER *err)
         }
 
 /* check to make sure the item is not already on this list */
-        for (last = *list; last; last = last->next) {
-                if (ascii_strcasecmp (rx->pattern, last->rx->pattern) == 0) {
-/* already on the list, so just ignore it */
-                        last = NULL;
-                        break;
-                }
-                if (!last->next)
-                        break;
-        }
-
-        if (!*list || last) {
-                t = mutt_new_rx_list();
-                t->rx = rx;
-                if (last) {
-                        last->next = t;
-                        last = last->next;
-                }
-                else
-                        *list = last = t;
-        }
-        else                                      /* duplicate */
-                mutt_free_regexp (&rx);
+        if (mutt_append_rx_list (list, rx) != 0)
+                mutt_free_regexp (&rx);             /* duplicate */
 
         return 0;
 }
@@ -860,6 +867,8 @@ static int parse_group (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 static void _attachments_clean (void)
 {
         int i;
+
+        unset_option (OPTATTACHRULESHASHED);
         if (Context && Context->msgcount) {
                 for (i = 0; i < Context->msgcount; i++)
                         Context->hdrs[i]->attach_valid = 0;
@@ -2205,17 +2214,12 @@ int mutt_parse_rc_line (/* const */ char *line, BUFFER *token, BUFFER *err)
                         continue;
                 }
                 mutt_extract_token (token, &expn, 0);
-                for (i = 0; Commands[i].name; i++) {
-                        if (!mutt_strcmp (token->data, Commands[i].name)) {
-                                if (Commands[i].func (token, &expn, Commands[i].data, err) != 0)
-                                        goto finish;
-                                break;
-                        }
-                }
-                if (!Commands[i].name) {
+                if ((i = mutt_command_index (token->data)) == -1) {
                         snprintf (err->data, err->dsize, _("%s: unknown command"), NONULL (token->data));
                         goto finish;
                 }
+                if (Commands[i].func (token, &expn, Commands[i].data, err) != 0)
+                        goto finish;
         }
         r = 0;
         finish:
@@ -2225,6 +2229,60 @@ int mutt_parse_rc_line (/* const */ char *line, BUFFER *token, BUFFER *err)
 }
 
 
+/* Look up the command LINE starts with, so that LINE can be run again
+ * through mutt_run_rc_command() without parsing the command name.
+ * Returns the index of the command and sets *ARGS to where its
+ * arguments start, or -1 if LINE must go through mutt_parse_rc_line(). */
+int mutt_lookup_rc_command (const char *line, size_t *args)
+{
+        const char *p, *name;
+        char buf[SHORT_STRING];
+        size_t len;
+        int i;
+
+        p = line;
+        SKIPWS (p);
+        for (name = p; isalnum ((unsigned char) *p) || *p == '-' || *p == '_'; p++)
+                ;
+        len = p - name;
+        if (!len || len >= sizeof (buf) || (*p && !ISSPACE (*p) && *p != ';'))
+                return -1;
+        SKIPWS (p);
+
+        memcpy (buf, name, len);
+        buf[len] = 0;
+        if ((i = mutt_command_index (buf)) != -1)
+                *args = p - line;
+        return i;
+}
+
+
+/* Run command CMD, as found by mutt_lookup_rc_command(), with the
+ * arguments at offset ARGS of LINE, followed by whatever else LINE
+ * holds.  Returns like mutt_parse_rc_line(). */
+int mutt_run_rc_command (int cmd, char *line, size_t args, BUFFER *token, BUFFER *err)
+{
+        BUFFER expn;
+        int r = 0;
+
+        mutt_buffer_init (&expn);
+        expn.data = line;
+        expn.dptr = line + args;
+        expn.dsize = mutt_strlen (line);
+
+        *err->data = 0;
+
+        if (Commands[cmd].func (token, &expn, Commands[cmd].data, err) != 0)
+                r = -1;
+        else if (*expn.dptr)
+                r = mutt_parse_rc_line (expn.dptr, token, err);
+
+        if (expn.destroy)
+                FREE (&expn.data);
+        return (r);
+}
+
+
 #define NUMVARS (sizeof (MuttVars)/sizeof (MuttVars[0]))
 #define NUMCOMMANDS (sizeof (Commands)/sizeof (Commands[0]))
 /* initial string that starts completion. No telling how much crap
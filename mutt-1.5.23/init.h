@@ -1187,6 +1187,32 @@ struct option_t MuttVars[] =
  ** so if you have problems you might want to try setting this variable to 0.
  ** .pp
  ** \fBNote:\fP Changes to this variable have no effect on open connections.
+ */
+        { "imap_prefetch",    DT_NUM,  R_NONE, UL &ImapPrefetch, 0 },
+/*
+ ** .pp
+ ** When set to a value greater than zero, mutt will use idle time while
+ ** waiting for input to fetch the bodies of this many messages following
+ ** the one you last opened (in index order) into the $$message_cachedir.
+ ** Reading through a thread then does not have to wait for the server.
+ ** Any keypress stops prefetching until mutt is idle again.
+ ** .pp
+ ** This option has no effect unless $$message_cachedir is set.
+ ** Also see $$imap_prefetch_delay and $$imap_prefetch_unread.
+ */
+        { "imap_prefetch_delay", DT_NUM, R_NONE, UL &ImapPrefetchDelay, 500 },
+/*
+ ** .pp
+ ** Specifies how many milliseconds mutt must be idle before it prefetches
+ ** the next message body, and so limits the rate at which bodies are
+ ** fetched in the background. See $$imap_prefetch.
+ */
+        { "imap_prefetch_unread", DT_NUM, R_NONE, UL &ImapPrefetchUnread, 0 },
+/*
+ ** .pp
+ ** When set to a value greater than zero, mutt will also prefetch the
+ ** bodies of all unread messages in the current IMAP folder whose size
+ ** does not exceed this many kilobytes. See $$imap_prefetch.
  */
         { "imap_servernoise",         DT_BOOL, R_NONE, OPTIMAPSERVERNOISE, 1 },
 /*
@@ -1422,6 +1448,16 @@ struct option_t MuttVars[] =
  ** folder will be appended.
  ** .pp
  ** Also see the $$move variable.
+ */
+        { "mbox_pad_status",  DT_BOOL, R_NONE, OPTMBOXPADSTATUS, 1 },
+/*
+ ** .pp
+ ** When \fIset\fP, Mutt always writes the ``Status:'' and ``X-Status:''
+ ** fields with room for every flag it keeps there when it rewrites an
+ ** mbox or MMDF folder.  Later changes to the read, old, replied and
+ ** flagged state of those messages can then be saved by overwriting a
+ ** few bytes in place, instead of rewriting the folder from the first
+ ** changed message onwards.  Deleting messages still rewrites the folder.
  */
         { "mbox_type",        DT_MAGIC,R_NONE, UL &DefaultMagic, M_MBOX },
 /*
@@ -1459,6 +1495,20 @@ struct option_t MuttVars[] =
  ** the mailbox is synchronized. You probably only want to set it
  ** every once in a while, since it can be a little slow
  ** (especially for large folders).
+ */
+        { "message_cache_size", DT_NUM, R_NONE, UL &MessageCacheSize, 0 },
+/*
+ ** .pp
+ ** When set to a positive number, mutt keeps the message cache of each
+ ** mailbox below this many megabytes by removing the messages that have
+ ** not been looked at for the longest time. A value of 0 means no limit.
+ ** The largest limit that can be set is 32767, i.e. 32 gigabytes.
+ ** .pp
+ ** The limit applies to each mailbox (for POP, each account) separately,
+ ** not to $$message_cachedir as a whole, which can grow to this size
+ ** times the number of cached mailboxes.
+ ** .pp
+ ** Also see the $$message_cachedir variable.
  */
         { "message_cachedir", DT_PATH,        R_NONE, UL &MessageCachedir, 0 },
 /*
@@ -1579,6 +1629,16 @@ struct option_t MuttVars[] =
  ** mixmaster chain.
  */
 #endif
+        { "mmap_messages",    DT_BOOL, R_NONE, OPTMMAPMESSAGES, 0 },
+/*
+ ** .pp
+ ** When \fIset\fP, large messages in Maildir and MH folders are mapped
+ ** into memory when opened, instead of being read through stdio every
+ ** time they are parsed, searched or displayed.  Messages in mbox and
+ ** MMDF folders are never mapped: those files are rewritten in place by
+ ** other programs, and a mapping of a file truncated under mutt would
+ ** crash it.
+ */
         { "move",             DT_QUAD, R_NONE, OPT_MOVE, M_NO },
 /*
  ** .pp
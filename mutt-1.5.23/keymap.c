@@ -411,6 +411,19 @@ int km_dokey (int menu)
         {
                 i = Timeout > 0 ? Timeout : 60;
 #ifdef USE_IMAP
+/* use idle gaps to prefetch message bodies, one per $imap_prefetch_delay.
+ * A keypress cancels prefetching until we are idle again. */
+                if ((menu == MENU_MAIN || menu == MENU_PAGER) &&
+                        imap_prefetch_pending ()) {
+                        do {
+                                timeout (ImapPrefetchDelay > 0 ? ImapPrefetchDelay : 1);
+                                tmp = mutt_getch ();
+                                timeout (-1);
+                                if (tmp.ch != -2 || SigWinch)
+                                        goto gotkey;
+                        }
+                        while (imap_prefetch () > 0 && imap_prefetch_pending ());
+                }
 /* keepalive may need to run more frequently than Timeout allows */
                 if (ImapKeepalive) {
                         if (ImapKeepalive >= i)
@@ -55,6 +55,11 @@ typedef struct
                 unsigned replied : 1;
         } flags;
         time_t received;                          /* the time at which this message was received */
+        const char *data;                         /* read-only mapping of the message, or NULL */
+        LOFF_T offset;                            /* file offset of data[0] */
+        size_t length;                            /* bytes available at data */
+        void *map;                                /* mapped region, for munmap() */
+        size_t maplen;
 } MESSAGE;
 
 CONTEXT *mx_open_mailbox (const char *, int, CONTEXT *);
@@ -68,6 +73,8 @@ int mx_close_mailbox (CONTEXT *, int *);
 int mx_sync_mailbox (CONTEXT *, int *);
 int mx_commit_message (MESSAGE *, CONTEXT *);
 int mx_close_message (MESSAGE **);
+const char *mx_message_data (MESSAGE *, LOFF_T, size_t *);
+void mx_cache_header (CONTEXT *, HEADER *);
 int mx_get_magic (const char *);
 int mx_set_magic (const char *);
 int mx_check_mailbox (CONTEXT *, int *, int);
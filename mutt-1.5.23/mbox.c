@@ -48,6 +48,15 @@ struct m_update_t
         LOFF_T length;
 };
 
+/* struct used by mbox_sync_in_place() to locate the status fields */
+struct m_status_t
+{
+        LOFF_T status;                            /* offset of the Status: value, or -1 */
+        size_t status_len;
+        LOFF_T xstatus;                           /* offset of the X-Status: value, or -1 */
+        size_t xstatus_len;
+};
+
 /* parameters:
  * ctx - context to lock
  * excl - exclusive lock?
@@ -677,6 +686,149 @@ void mbox_reset_atime (CONTEXT *ctx, struct stat *st)
 }
 
 
+/* record where the value of a Status: or X-Status: field starts and how
+ * much room it has, up to the line terminator.  returns -1 if the field
+ * has been seen before or the line is too long to be rewritten safely.
+ */
+static int mbox_status_field (const char *buf, size_t taglen, LOFF_T pos,
+LOFF_T *off, size_t *len)
+{
+        size_t l = mutt_strlen (buf);
+
+        if (*off != -1 || l == 0 || buf[l - 1] != '\n')
+                return -1;
+        l--;
+        if (l > taglen && buf[l - 1] == '\r')
+                l--;
+        *off = pos + taglen;
+        *len = l - taglen;
+        return 0;
+}
+
+
+static int mbox_find_status (CONTEXT *ctx, HEADER *h, struct m_status_t *st)
+{
+        char buf[LONG_STRING];
+        LOFF_T pos;
+        int bol = 1;
+
+        st->status = st->xstatus = -1;
+
+        if (fseeko (ctx->fp, h->offset, SEEK_SET) != 0)
+                return -1;
+
+/* make sure the message is where we expect it */
+        if (fgets (buf, sizeof (buf), ctx->fp) == NULL ||
+                (ctx->magic == M_MBOX && mutt_strncmp ("From ", buf, 5) != 0))
+                return -1;
+        bol = (strchr (buf, '\n') != NULL);
+
+        while ((pos = ftello (ctx->fp)) < h->content->offset &&
+        fgets (buf, sizeof (buf), ctx->fp) != NULL) {
+                if (bol) {
+                        if (ascii_strncasecmp ("Status:", buf, 7) == 0) {
+                                if (mbox_status_field (buf, 7, pos, &st->status, &st->status_len) != 0)
+                                        return -1;
+                        }
+                        else if (ascii_strncasecmp ("X-Status:", buf, 9) == 0) {
+                                if (mbox_status_field (buf, 9, pos, &st->xstatus, &st->xstatus_len) != 0)
+                                        return -1;
+                        }
+                }
+                bol = (strchr (buf, '\n') != NULL);
+        }
+
+        return 0;
+}
+
+
+/* overwrite a status field value with `val', padded with blanks.  returns
+ * 1 if the field has no room for the value.
+ */
+static int mbox_write_status (FILE *fp, LOFF_T off, size_t len, const char *val, int dry_run)
+{
+        size_t l = mutt_strlen (val);
+
+        if (off == -1)
+                return l ? 1 : 0;
+        if (l && l + 1 > len)
+                return 1;
+        if (dry_run || len == 0)
+                return 0;
+
+        if (fseeko (fp, off, SEEK_SET) != 0)
+                return -1;
+        if (l)
+                fprintf (fp, " %s", val);
+        for (l = l ? l + 1 : 0; l < len; l++)
+                fputc (' ', fp);
+        return ferror (fp) ? -1 : 0;
+}
+
+
+/* save flag changes by rewriting the Status: and X-Status: fields of the
+ * changed messages where they are.  only possible if no message is deleted
+ * or has had its headers edited, and the new flags fit in the old fields.
+ * returns 0 on success, -1 if the mailbox has to be rewritten instead.
+ */
+static int mbox_sync_in_place (CONTEXT *ctx)
+{
+        struct m_status_t *fields;
+        char status[3], xstatus[3], *p;
+        HEADER *h;
+        int i, j, n = 0, pass, rc = -1;
+
+        for (i = 0; i < ctx->msgcount; i++) {
+                h = ctx->hdrs[i];
+                if (h->deleted || h->attach_del ||
+                        (h->env && (h->env->irt_changed || h->env->refs_changed)))
+                        return -1;
+                if (h->changed)
+                        n++;
+        }
+        if (n == 0)
+                return -1;
+
+        fields = safe_calloc (n, sizeof (struct m_status_t));
+        for (i = 0, j = 0; i < ctx->msgcount; i++) {
+                if (ctx->hdrs[i]->changed &&
+                        mbox_find_status (ctx, ctx->hdrs[i], &fields[j++]) != 0)
+                        goto out;
+        }
+
+/* first make sure everything fits, then write */
+        for (pass = 1; pass >= 0; pass--) {
+                for (i = 0, j = 0; i < ctx->msgcount; i++) {
+                        h = ctx->hdrs[i];
+                        if (!h->changed)
+                                continue;
+
+                        strfcpy (status, h->read ? "RO" : (h->old ? "O" : ""), sizeof (status));
+                        p = xstatus;
+                        if (h->replied)
+                                *p++ = 'A';
+                        if (h->flagged)
+                                *p++ = 'F';
+                        *p = 0;
+
+                        if (mbox_write_status (ctx->fp, fields[j].status,
+                                fields[j].status_len, status, pass) != 0 ||
+                                mbox_write_status (ctx->fp, fields[j].xstatus,
+                                fields[j].xstatus_len, xstatus, pass) != 0)
+                                goto out;
+                        j++;
+                }
+        }
+
+        if (fflush (ctx->fp) == 0 && !ferror (ctx->fp))
+                rc = 0;
+
+        out:
+        FREE (&fields);
+        return rc;
+}
+
+
 /* return values:
  *	0	success
  *	-1	failure
@@ -734,6 +886,25 @@ int mbox_sync_mailbox (CONTEXT *ctx, int *index_hint)
 /* fatal error */
                 return (-1);
 
+/* flag changes alone can often be saved without touching the rest of the
+ * mailbox.  if that fails half way, the full rewrite below recreates the
+ * status fields from scratch anyway.
+ */
+        if (stat (ctx->path, &statbuf) == 0 && mbox_sync_in_place (ctx) == 0) {
+                mbox_unlock_mailbox (ctx);
+                i = fclose (ctx->fp);
+                ctx->fp = NULL;
+                mbox_reset_atime (ctx, &statbuf);
+                if (i != 0 || (ctx->fp = fopen (ctx->path, "r")) == NULL) {
+                        mutt_unblock_signals ();
+                        mx_fastclose_mailbox (ctx);
+                        mutt_error _("Fatal error!  Could not reopen mailbox!");
+                        return (-1);
+                }
+                mutt_unblock_signals ();
+                return (0);
+        }
+
 /* Create a temporary file to write the new version of the mailbox in. */
         mutt_mktemp (tempfile, sizeof (tempfile));
         if ((i = open (tempfile, O_WRONLY | O_EXCL | O_CREAT, 0600)) == -1 ||
@@ -819,7 +990,8 @@ int mbox_sync_mailbox (CONTEXT *ctx, int *index_hint)
                         newOffset[i - first].hdr = ftello (fp) + offset;
 
                         if (mutt_copy_message (fp, ctx, ctx->hdrs[i], M_CM_UPDATE,
-                        CH_FROM | CH_UPDATE | CH_UPDATE_LEN) != 0) {
+                                CH_FROM | CH_UPDATE | CH_UPDATE_LEN |
+                        (option (OPTMBOXPADSTATUS) ? CH_PAD_STATUS : 0)) != 0) {
                                 mutt_perror (tempfile);
                                 mutt_sleep (5);
                                 unlink (tempfile);
@@ -199,12 +199,90 @@ static void menu_pad_string (char *s, size_t n)
 }
 
 
+/* Rows drawn by menu_redraw_index() are remembered, so that the next
+ * redraw only touches rows whose text, colour or indicator changed.  The
+ * records are dropped when the screen is cleared or the layout changes. */
+static void menu_row_clear (MENU_ROW *row)
+{
+        FREE (&row->text);
+        row->valid = 0;
+}
+
+
+static int menu_row_options (void)
+{
+        return (option (OPTARROWCURSOR) ? 1 : 0) |
+                (option (OPTSTATUSONTOP) ? 2 : 0) |
+                (option (OPTHELP) ? 4 : 0);
+}
+
+
+static void menu_check_rows (MUTTMENU *menu)
+{
+        int i;
+
+        if (menu->rows_serial == ScreenSerial && menu->nrows == MAX (menu->pagelen, 0) &&
+                menu->rows_cols == COLS && menu->rows_sidebar == SidebarWidth &&
+                menu->rows_offset == menu->offset && menu->rows_options == menu_row_options ())
+                return;
+
+        for (i = 0; i < menu->nrows; i++)
+                menu_row_clear (&menu->rows[i]);
+        menu_row_clear (&menu->status);
+
+        menu->nrows = MAX (menu->pagelen, 0);
+        safe_realloc (&menu->rows, menu->nrows * sizeof (MENU_ROW));
+        if (menu->rows)
+                memset (menu->rows, 0, menu->nrows * sizeof (MENU_ROW));
+
+        menu->rows_serial = ScreenSerial;
+        menu->rows_cols = COLS;
+        menu->rows_sidebar = SidebarWidth;
+        menu->rows_offset = menu->offset;
+        menu->rows_options = menu_row_options ();
+}
+
+
+/* returns 1 if row already shows text in attr, otherwise records it as
+ * what the caller is about to draw and returns 0 */
+static int menu_row_unchanged (MENU_ROW *row, const char *text, int attr, int current)
+{
+        if (row->valid && row->attr == attr && row->current == current &&
+                !mutt_strcmp (row->text, text))
+                return 1;
+
+        mutt_str_replace (&row->text, text);
+        row->attr = attr;
+        row->current = current;
+        row->valid = 1;
+        return 0;
+}
+
+
+/* forget a row that is being drawn outside of menu_redraw_index() */
+static void menu_row_damage (MUTTMENU *menu, int i)
+{
+        i -= menu->top;
+        if (i >= 0 && i < menu->nrows)
+                menu_row_clear (&menu->rows[i]);
+}
+
+
+/* returns 1 if the status line already shows buf */
+int menu_status_unchanged (MUTTMENU *menu, const char *buf)
+{
+        menu_check_rows (menu);
+        return menu_row_unchanged (&menu->status, buf, ColorDefs[MT_COLOR_STATUS], 0);
+}
+
+
 void menu_redraw_full (MUTTMENU *menu)
 {
         NORMAL_COLOR;
 /* clear() doesn't optimize screen redraws */
         move (0, 0);
         clrtobot ();
+        ScreenSerial++;
 
         if (option (OPTHELP)) {
                 SETCOLOR (MT_COLOR_STATUS);
@@ -230,10 +308,12 @@ void menu_redraw_status (MUTTMENU *menu)
         char buf[STRING];
 
         snprintf (buf, sizeof (buf), M_MODEFMT, menu->title);
-        SETCOLOR (MT_COLOR_STATUS);
-        move (option (OPTSTATUSONTOP) ? 0 : LINES - 2, 0);
-        mutt_paddstr (COLS, buf);
-        NORMAL_COLOR;
+        if (!menu_status_unchanged (menu, buf)) {
+                SETCOLOR (MT_COLOR_STATUS);
+                move (option (OPTSTATUSONTOP) ? 0 : LINES - 2, 0);
+                mutt_paddstr (COLS, buf);
+                NORMAL_COLOR;
+        }
         menu->redraw &= ~REDRAW_STATUS;
 }
 
@@ -241,18 +321,24 @@ void menu_redraw_status (MUTTMENU *menu)
 void menu_redraw_index (MUTTMENU *menu)
 {
         char buf[LONG_STRING];
+        MENU_ROW *row;
         int i;
         int do_color;
         int attr;
 
         draw_sidebar(1);
+        menu_check_rows (menu);
         for (i = menu->top; i < menu->top + menu->pagelen; i++) {
+                row = &menu->rows[i - menu->top];
                 if (i < menu->max) {
                         attr = menu->color(i);
 
                         menu_make_entry (buf, sizeof (buf), menu, i);
                         menu_pad_string (buf, sizeof (buf));
 
+                        if (menu_row_unchanged (row, buf, attr, i == menu->current))
+                                continue;
+
                         ATTRSET(attr);
                         move(i - menu->top + menu->offset, SidebarWidth);
                         do_color = 1;
@@ -272,7 +358,7 @@ void menu_redraw_index (MUTTMENU *menu)
 
                         print_enriched_string (attr, (unsigned char *) buf, do_color);
                 }
-                else {
+                else if (!menu_row_unchanged (row, NULL, ColorDefs[MT_COLOR_NORMAL], 0)) {
                         NORMAL_COLOR;
                         CLEARLINE_WIN(i - menu->top + menu->offset);
                 }
@@ -291,6 +377,9 @@ void menu_redraw_motion (MUTTMENU *menu)
                 return;
         }
 
+        menu_row_damage (menu, menu->oldcurrent);
+        menu_row_damage (menu, menu->current);
+
         move (menu->oldcurrent + menu->offset - menu->top, SidebarWidth);
         ATTRSET(menu->color (menu->oldcurrent));
 
@@ -332,6 +421,8 @@ void menu_redraw_current (MUTTMENU *menu)
         char buf[LONG_STRING];
         int attr = menu->color (menu->current);
 
+        menu_row_damage (menu, menu->current);
+
         move (menu->current + menu->offset - menu->top, SidebarWidth);
         menu_make_entry (buf, sizeof (buf), menu, menu->current);
         menu_pad_string (buf, sizeof (buf));
@@ -706,6 +797,11 @@ void mutt_menuDestroy (MUTTMENU **p)
                 FREE (& (*p)->dialog);
         }
 
+        for (i = 0; i < (*p)->nrows; i++)
+                FREE (&(*p)->rows[i].text);
+        FREE (&(*p)->rows);
+        FREE (&(*p)->status.text);
+
         FREE (p);                                 /* __FREE_CHECKED__ */
 }
 
@@ -867,6 +867,32 @@ static size_t maildir_hcache_keylen (const char *fn)
         const char * p = strrchr (fn, ':');
         return p ? (size_t) (p - fn) : mutt_strlen(fn);
 }
+
+
+/* store the headers queued by mx_cache_header(), with a single open of
+ * the cache */
+void mh_cache_headers (CONTEXT * ctx)
+{
+        header_cache_t *hc;
+        HEADER *h;
+        int i;
+
+        hc = mutt_hcache_open (HeaderCache, ctx->path, NULL);
+        for (i = 0; i < ctx->msgcount; i++) {
+                h = ctx->hdrs[i];
+                if (!h->hcache_dirty)
+                        continue;
+                h->hcache_dirty = 0;
+                if (!hc || !h->path)
+                        continue;
+                if (ctx->magic == M_MAILDIR)
+                        mutt_hcache_store (hc, h->path + 3, h, 0, &maildir_hcache_keylen, M_GENERATE_UIDVALIDITY);
+                else
+                        mutt_hcache_store (hc, h->path, h, 0, strlen, M_GENERATE_UIDVALIDITY);
+        }
+        if (hc)
+                mutt_hcache_close (hc);
+}
 #endif
 
 #if HAVE_DIRENT_D_INO
@@ -1106,6 +1132,10 @@ progress_t *progress)
 
                 if (data != NULL && !ret && lastchanged.st_mtime <= when->tv_sec) {
                         p->h = mutt_hcache_restore ((unsigned char *)data, &p->h);
+/* the cached MIME structure only describes a file of the same size */
+                        if (p->h->content->parts && option(OPTHCACHEVERIFY) &&
+                                lastchanged.st_size != p->h->content->offset + p->h->content->length)
+                                mutt_free_body (&p->h->content->parts);
                         if (ctx->magic == M_MAILDIR)
                                 maildir_parse_flags (p->h, fn);
                 }
@@ -389,6 +389,7 @@ enum
         OPTMAILDIRTRASH,
         OPTMARKERS,
         OPTMARKOLD,
+        OPTMBOXPADSTATUS,
         OPTMENUSCROLL,                            /* scroll menu instead of implicit next-page */
         OPTMENUMOVEOFF,                           /* allow menu to scroll past last entry */
 #if defined(USE_IMAP) || defined(USE_POP)
@@ -398,6 +399,7 @@ enum
         OPTMETOO,
         OPTMHPURGE,
         OPTMIMEFORWDECODE,
+        OPTMMAPMESSAGES,
         OPTNARROWTREE,
         OPTPAGERSTOP,
         OPTPIPEDECODE,
@@ -512,6 +514,7 @@ enum
         OPTPGPCHECKTRUST,                         /* (pseudo) used by pgp_select_key () */
         OPTDONTHANDLEPGPKEYS,                     /* (pseudo) used to extract PGP keys */
         OPTUNBUFFEREDINPUT,                       /* (pseudo) don't use key buffer */
+        OPTATTACHRULESHASHED,                     /* (pseudo) hcache's attachment rules hash is current */
 
         OPTMAX
 };
@@ -560,6 +563,7 @@ int mutt_matches_ignore (const char *, LIST *);
 LIST *mutt_add_list (LIST *, const char *);
 LIST *mutt_add_list_n (LIST*, const void *, size_t);
 LIST *mutt_find_list (LIST *, const char *);
+int mutt_append_rx_list (RX_LIST **list, REGEXP *rx);
 int mutt_remove_from_rx_list (RX_LIST **l, const char *str);
 
 void mutt_init (int, LIST *);
@@ -750,6 +754,9 @@ typedef struct header
 /* tells whether the attachment count is valid */
         unsigned int attach_valid : 1;
 
+/* waiting to be written back to the header cache, see mx_cache_header() */
+        unsigned int hcache_dirty : 1;
+
 /* the following are used to support collapsing threads  */
         unsigned int collapsed : 1;               /* is this message part of a collapsed thread? */
         unsigned int limited : 1;                 /* is this message in a limited view?  */
@@ -758,6 +765,7 @@ typedef struct header
         short recipient;                          /* user_is_recipient()'s return value, cached */
 
         int pair;                                 /* color-pair to use when displaying in the index */
+        short color_rule;                         /* position of the index color rule pair came from */
 
         time_t date_sent;                         /* time when the message was sent (UTC) */
         time_t received;                          /* time when the message was placed in the mailbox */
@@ -767,6 +775,8 @@ typedef struct header
         int msgno;                                /* number displayed to the user */
         int virtual;                              /* virtual message number */
         int score;
+        unsigned char *score_bits;                /* cached score rule results, see score.c */
+        unsigned int score_layout;                /* which rules score_bits covers */
         ENVELOPE *env;                            /* envelope information */
         BODY *content;                            /* list of MIME parts */
         char *path;
@@ -802,6 +812,7 @@ struct mutt_thread
         unsigned int deep : 1;
         unsigned int subtree_visible : 2;
         unsigned int next_subtree_visible : 1;
+        unsigned int redraw_tree : 1;
         THREAD *parent;
         THREAD *child;
         THREAD *next;
@@ -843,6 +854,7 @@ typedef struct pattern_t
         int max;
         struct pattern_t *next;
         struct pattern_t *child;                  /* arguments to logical op */
+        char *rxsrc;                              /* regexp p.rx was compiled from */
         union
         {
                 regex_t *rx;
@@ -851,6 +863,23 @@ typedef struct pattern_t
         } p;
 } pattern_t;
 
+/* what the result of a pattern may depend on, see mutt_pattern_deps() */
+#define M_DEP_READ      (1<<0)                    /* read and old flags */
+#define M_DEP_DELETED   (1<<1)
+#define M_DEP_FLAGGED   (1<<2)
+#define M_DEP_TAGGED    (1<<3)
+#define M_DEP_REPLIED   (1<<4)
+#define M_DEP_EXPIRED   (1<<5)                    /* expired and superseded */
+#define M_DEP_ENVELOPE  (1<<6)                    /* addresses, subject, ids, labels */
+#define M_DEP_HEADER    (1<<7)                    /* dates and size */
+#define M_DEP_SCORE     (1<<8)
+#define M_DEP_SECURITY  (1<<9)
+#define M_DEP_CONTENT   (1<<10)                   /* message text and attachments */
+#define M_DEP_THREAD    (1<<11)                   /* other messages in the thread */
+#define M_DEP_POSITION  (1<<12)                   /* message number */
+#define M_DEP_CONFIG    (1<<13)                   /* lists, alternates and groups */
+#define M_DEP_FLAGS     (M_DEP_READ|M_DEP_DELETED|M_DEP_FLAGGED|M_DEP_TAGGED|M_DEP_REPLIED|M_DEP_EXPIRED)
+
 /* ACL Rights */
 enum
 {
@@ -895,6 +924,7 @@ typedef struct _context
         int deleted;                              /* how many deleted messages */
         int flagged;                              /* how many flagged messages */
         int msgnotreadyet;                        /* which msg "new" in pager, -1 if none */
+        int hcache_dirty;                         /* headers queued for the header cache */
 
         short magic;                              /* mailbox type */
 
@@ -139,6 +139,9 @@ void crypt_forget_passphrase (void);
 /* Check that we have a usable passphrase, ask if not. */
 int crypt_valid_passphrase (int);
 
+/* Compute a stamp that changes whenever the keyring files change. */
+int crypt_keyring_stamp (unsigned long *stamp);
+
 /* Write the message body/part A described by state S to a the given
    TEMPFILE.  */
 int crypt_write_signed(BODY *a, STATE *s, const char *tempf);
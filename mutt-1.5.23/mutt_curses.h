@@ -97,6 +97,10 @@ void mutt_resize_screen (void);
 void mutt_ungetch (int, int);
 void mutt_need_hard_redraw (void);
 
+/* bumped whenever the whole screen is cleared; code that skips redrawing
+ * unchanged rows must forget what it drew when this changes */
+extern unsigned int ScreenSerial;
+
 /* ----------------------------------------------------------------------------
  * Support for color
  */
@@ -135,6 +139,7 @@ typedef struct color_line
         pattern_t *color_pattern;
 /* compiled pattern to speed up index color
                                calculation */
+        int deps;                                 /* what color_pattern depends on */
         short fg;
         short bg;
         int pair;
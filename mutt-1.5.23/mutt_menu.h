@@ -37,6 +37,15 @@
 
 #define M_MODEFMT "-- Mutt: %s"
 
+/* what a redraw last put on one screen row of a menu */
+typedef struct menu_row
+{
+        char *text;
+        int attr;
+        int current;                              /* row showed the indicator */
+        int valid;
+} MENU_ROW;
+
 typedef struct menu_t
 {
         char *title;                              /* the title of this menu */
@@ -77,6 +86,17 @@ typedef struct menu_t
         int oldcurrent;                           /* for driver use only. */
         int searchDir;                            /* direction of search */
         int tagged;                               /* number of tagged entries */
+
+/* the following are used only by the menu_redraw_* functions, to skip
+ * rows that are already on the screen */
+        MENU_ROW *rows;                           /* index rows, from menu->top */
+        int nrows;
+        MENU_ROW status;                          /* the status line */
+        unsigned int rows_serial;                 /* ScreenSerial they were drawn in */
+        int rows_cols;                            /* COLS they were drawn with */
+        int rows_sidebar;                         /* SidebarWidth they were drawn with */
+        int rows_offset;                          /* offset they were drawn at */
+        int rows_options;                         /* layout options they were drawn with */
 } MUTTMENU;
 
 void mutt_menu_init (void);
@@ -86,6 +106,7 @@ void menu_redraw_index (MUTTMENU *);
 void menu_redraw_status (MUTTMENU *);
 void menu_redraw_motion (MUTTMENU *);
 void menu_redraw_current (MUTTMENU *);
+int menu_status_unchanged (MUTTMENU *, const char *);
 int  menu_redraw (MUTTMENU *);
 void menu_first_entry (MUTTMENU *);
 void menu_last_entry (MUTTMENU *);
@@ -260,11 +260,112 @@ LIST *mutt_find_list (LIST *l, const char *data)
 }
 
 
+/* Long rx lists (lists, subscribe, alternates, ...) get a side index of
+ * their patterns, so that appending to them during startup does not rescan
+ * the whole list for duplicates.  An index is only ever extended by
+ * mutt_append_rx_list(); any other edit of the list drops it, and it is
+ * rebuilt on the next append. */
+#define RX_INDEX_MIN 32
+
+typedef struct rx_index
+{
+        RX_LIST **list;
+        RX_LIST *head;
+        RX_LIST *tail;
+        HASH *patterns;
+        struct rx_index *next;
+} RX_INDEX;
+
+static RX_INDEX *RxIndexes = NULL;
+
+static RX_INDEX **rx_index_slot (RX_LIST **list)
+{
+        RX_INDEX **ix;
+
+        for (ix = &RxIndexes; *ix; ix = &(*ix)->next)
+                if ((*ix)->list == list)
+                        break;
+        return ix;
+}
+
+
+static void rx_index_drop (RX_LIST **list)
+{
+        RX_INDEX **slot, *ix;
+
+        if (!RxIndexes)
+                return;
+        slot = rx_index_slot (list);
+        if ((ix = *slot) == NULL)
+                return;
+        *slot = ix->next;
+        hash_destroy (&ix->patterns, NULL);
+        FREE (&ix);
+}
+
+
+/* appends rx to the list unless an equal pattern is already there.
+ * returns 0 if rx was added, 1 if it is a duplicate (the caller keeps it). */
+int mutt_append_rx_list (RX_LIST **list, REGEXP *rx)
+{
+        RX_INDEX *ix = *rx_index_slot (list);
+        RX_LIST *last, *t;
+        int n = 0;
+
+        if (ix && ix->head != *list) {
+                rx_index_drop (list);
+                ix = NULL;
+        }
+
+        if (ix) {
+                if (hash_find (ix->patterns, rx->pattern))
+                        return 1;
+                last = ix->tail;
+        }
+        else {
+                for (last = *list; last; last = last->next) {
+                        if (ascii_strcasecmp (rx->pattern, last->rx->pattern) == 0)
+                                return 1;
+                        n++;
+                        if (!last->next)
+                                break;
+                }
+        }
+
+        t = mutt_new_rx_list();
+        t->rx = rx;
+        if (last)
+                last->next = t;
+        else
+                *list = t;
+
+        if (ix) {
+                hash_insert (ix->patterns, t->rx->pattern, t, 1);
+                ix->tail = t;
+        }
+        else if (n + 1 >= RX_INDEX_MIN) {
+                ix = safe_calloc (1, sizeof (RX_INDEX));
+                ix->list = list;
+                ix->head = *list;
+                ix->tail = t;
+                ix->patterns = hash_create (1031, 1);
+                for (last = *list; last; last = last->next)
+                        hash_insert (ix->patterns, last->rx->pattern, last, 1);
+                ix->next = RxIndexes;
+                RxIndexes = ix;
+        }
+
+        return 0;
+}
+
+
 int mutt_remove_from_rx_list (RX_LIST **l, const char *str)
 {
         RX_LIST *p, *last = NULL;
         int rv = -1;
 
+        rx_index_drop (l);
+
         if (mutt_strcmp ("*", str) == 0) {
                 mutt_free_rx_list (l);            /* ``unCMD *'' means delete all current entries */
                 rv = 0;
@@ -324,6 +425,7 @@ void mutt_free_header (HEADER **h)
         FREE (&(*h)->maildir_flags);
         FREE (&(*h)->tree);
         FREE (&(*h)->path);
+        FREE (&(*h)->score_bits);
 #ifdef MIXMASTER
         mutt_free_list (&(*h)->chain);
 #endif
@@ -1805,6 +1907,7 @@ void mutt_free_rx_list (RX_LIST **list)
         RX_LIST *p;
 
         if (!list) return;
+        rx_index_drop (list);
         while (*list) {
                 p = *list;
                 *list = (*list)->next;
@@ -57,6 +57,10 @@
 #include <ctype.h>
 #include <utime.h>
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 #define mutt_is_spool(s)  (mutt_strcmp (Spoolfile, s) == 0)
 
 #ifdef USE_DOTLOCK
@@ -670,6 +674,30 @@ CONTEXT *mx_open_mailbox (const char *path, int flags, CONTEXT *pctx)
 }
 
 
+/* store the headers queued by mx_cache_header() */
+static void mx_flush_hcache (CONTEXT *ctx)
+{
+#ifdef USE_HCACHE
+        if (!ctx->hcache_dirty)
+                return;
+
+        switch (ctx->magic) {
+                case M_MH:
+                case M_MAILDIR:
+                        mh_cache_headers (ctx);
+                        break;
+
+#ifdef USE_IMAP
+                case M_IMAP:
+                        imap_cache_headers (ctx);
+                        break;
+#endif
+        }
+        ctx->hcache_dirty = 0;
+#endif
+}
+
+
 /* free up memory associated with the mailbox context */
 void mx_fastclose_mailbox (CONTEXT *ctx)
 {
@@ -693,6 +721,7 @@ void mx_fastclose_mailbox (CONTEXT *ctx)
  * XXX: really belongs in mx_close_mailbox, but this is a nice hook point */
         mutt_buffy_setnotified(ctx->path);
 
+        mx_flush_hcache (ctx);
         if (ctx->mx_close)
                 ctx->mx_close (ctx);
 
@@ -1231,6 +1260,7 @@ int mx_check_mailbox (CONTEXT *ctx, int *index_hint, int lock)
         int rc;
 
         if (ctx) {
+                mx_flush_hcache (ctx);
                 if (ctx->locked) lock = 0;
 
                 switch (ctx->magic) {
@@ -1280,6 +1310,69 @@ int mx_check_mailbox (CONTEXT *ctx, int *index_hint, int lock)
 }
 
 
+/* smaller messages are cheaper to read through stdio than to map */
+#define MX_MAP_MIN 16384
+
+/*
+ * Map a local message into memory, so that its raw bytes can be used
+ * directly through mx_message_data().  This is an optimization only:
+ * msg->fp stays valid, and if mapping fails msg->data is left NULL.
+ */
+static void mx_map_message (MESSAGE *msg, HEADER *h)
+{
+#ifdef HAVE_MMAP
+        struct stat st;
+        LOFF_T start, end, pagestart;
+        long pagesize;
+        void *map;
+
+        if (!msg->fp || !h->content || fstat (fileno (msg->fp), &st) < 0 ||
+                !S_ISREG (st.st_mode))
+                return;
+
+        start = h->offset;
+        end = MIN (h->content->offset + h->content->length, st.st_size);
+        if (end - start < MX_MAP_MIN)
+                return;
+
+        if ((pagesize = sysconf (_SC_PAGESIZE)) <= 0)
+                return;
+        pagestart = start - start % pagesize;
+
+        map = mmap (NULL, end - pagestart, PROT_READ, MAP_PRIVATE,
+                fileno (msg->fp), pagestart);
+        if (map == MAP_FAILED) {
+                dprint (1, (debugfile, "mx_map_message: mmap: %s (errno %d).\n",
+                        strerror (errno), errno));
+                return;
+        }
+
+        msg->map = map;
+        msg->maplen = end - pagestart;
+        msg->data = (const char *) map + (start - pagestart);
+        msg->offset = start;
+        msg->length = end - start;
+#endif
+}
+
+
+/*
+ * Returns the mapped bytes of an open message starting at file offset
+ * off, and sets *len to the number of bytes available from there.
+ * Returns NULL if the message, or that part of it, is not mapped; the
+ * caller must then read msg->fp instead.
+ */
+const char *mx_message_data (MESSAGE *msg, LOFF_T off, size_t *len)
+{
+        if (!msg || !msg->data || off < msg->offset ||
+                off >= msg->offset + (LOFF_T) msg->length)
+                return NULL;
+
+        *len = msg->length - (off - msg->offset);
+        return msg->data + (off - msg->offset);
+}
+
+
 /* return a stream pointer for a message */
 MESSAGE *mx_open_message (CONTEXT *ctx, int msgno)
 {
@@ -1336,6 +1429,12 @@ MESSAGE *mx_open_message (CONTEXT *ctx, int msgno)
                         FREE (&msg);
                         break;
         }
+
+/* not mbox/MMDF: a mapping of a file truncated by someone else raises SIGBUS */
+        if (msg && option (OPTMMAPMESSAGES) &&
+                (ctx->magic == M_MH || ctx->magic == M_MAILDIR))
+                mx_map_message (msg, ctx->hdrs[msgno]);
+
         return (msg);
 }
 
@@ -1404,6 +1503,11 @@ int mx_close_message (MESSAGE **msg)
 {
         int r = 0;
 
+#ifdef HAVE_MMAP
+        if ((*msg)->map)
+                munmap ((*msg)->map, (*msg)->maplen);
+#endif
+
         if ((*msg)->magic == M_MH || (*msg)->magic == M_MAILDIR
         || (*msg)->magic == M_IMAP || (*msg)->magic == M_POP) {
                 r = safe_fclose (&(*msg)->fp);
@@ -1423,6 +1527,29 @@ int mx_close_message (MESSAGE **msg)
 }
 
 
+/* queue a header to be written back to the header cache once its MIME
+ * structure has been parsed, so that the structure need not be parsed
+ * again.  A pass over a whole folder (%X, ~X) queues many of them, so
+ * they are stored together by mx_flush_hcache(). */
+void mx_cache_header (CONTEXT *ctx, HEADER *h)
+{
+#ifdef USE_HCACHE
+        switch (ctx->magic) {
+                case M_MH:
+                case M_MAILDIR:
+#ifdef USE_IMAP
+                case M_IMAP:
+#endif
+                        if (!h->hcache_dirty) {
+                                h->hcache_dirty = 1;
+                                ctx->hcache_dirty++;
+                        }
+                        break;
+        }
+#endif
+}
+
+
 void mx_alloc_memory (CONTEXT *ctx)
 {
         int i;
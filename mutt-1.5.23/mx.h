@@ -59,6 +59,9 @@ int mh_sync_mailbox (CONTEXT *, int *);
 int mh_check_mailbox (CONTEXT *, int *);
 void mh_buffy_update (const char *, int *, int *, int *);
 int mh_check_empty (const char *);
+#if USE_HCACHE
+void mh_cache_headers (CONTEXT *);
+#endif
 
 int maildir_read_dir (CONTEXT *);
 int maildir_check_mailbox (CONTEXT *, int *);
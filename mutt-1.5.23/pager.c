@@ -1527,6 +1527,7 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
 /* clear() doesn't optimize screen redraws */
                         move (0, 0);
                         clrtobot ();
+                        ScreenSerial++;
 
                         if (IsHeader (extra) && Context->vcount + 1 < PagerIndexLines)
                                 indexlen = Context->vcount + 1;
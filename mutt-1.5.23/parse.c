@@ -530,6 +530,53 @@ BODY *mutt_parse_messageRFC822 (FILE *fp, BODY *parent)
 }
 
 
+/*
+ * The message mutt_parse_mime_message() is parsing, so that
+ * skip_to_boundary() can use its mapping.  It is set just before the
+ * mutt_parse_part() call there and cleared just after, and nowhere
+ * else; the nested calls to mutt_parse_multipart() reach it through
+ * here rather than through an argument that all the other callers of
+ * the parse functions would have to pass as NULL.  skip_to_boundary()
+ * only uses it while reading ParseMsg->fp, so other streams parsed
+ * meanwhile are unaffected.
+ */
+static MESSAGE *ParseMsg = NULL;
+
+/*
+ * Skip ahead in a mapped message to the next chunk that fgets() would
+ * return and that starts with "--boundary", and seek fp there.  Chunks
+ * are emulated exactly, so mutt_parse_multipart() sees the same
+ * candidate lines as if it had read everything itself.  Returns the
+ * new file offset.
+ */
+static LOFF_T skip_to_boundary (FILE *fp, const char *boundary, int blen, LOFF_T end_off)
+{
+        LOFF_T off = ftello (fp), start = off;
+        const char *p, *nl;
+        size_t avail, n;
+
+        if (!ParseMsg || fp != ParseMsg->fp ||
+                !(p = mx_message_data (ParseMsg, off, &avail)))
+                return off;
+
+/* leave the last stretch of the mapping to fgets() */
+        while (off < end_off && avail >= LONG_STRING + blen + 2) {
+                if (p[0] == '-' && p[1] == '-' && !strncmp (p + 2, boundary, blen))
+                        break;
+                n = LONG_STRING - 1;
+                if ((nl = memchr (p, '\n', n)))
+                        n = nl - p + 1;
+                p += n;
+                avail -= n;
+                off += n;
+        }
+
+        if (off != start)
+                fseeko (fp, off, SEEK_SET);
+        return off;
+}
+
+
 /* parse a multipart structure
  *
  * args:
@@ -560,7 +607,8 @@ BODY *mutt_parse_multipart (FILE *fp, const char *boundary, LOFF_T end_off, int
         }
 
         blen = mutt_strlen (boundary);
-        while (ftello (fp) < end_off && fgets (buffer, LONG_STRING, fp) != NULL) {
+        while (skip_to_boundary (fp, boundary, blen, end_off) < end_off &&
+                fgets (buffer, LONG_STRING, fp) != NULL) {
                 len = mutt_strlen (buffer);
 
                 crlf =  (len > 1 && buffer[len - 2] == '\r') ? 1 : 0;
@@ -984,12 +1032,17 @@ void mutt_parse_mime_message (CONTEXT *ctx, HEADER *cur)
                         break;                    /* The message was parsed earlier. */
 
                 if ((msg = mx_open_message (ctx, cur->msgno))) {
+                        ParseMsg = msg;
                         mutt_parse_part (msg->fp, cur->content);
+                        ParseMsg = NULL;
 
                         if (WithCrypto)
                                 cur->security = crypt_query (cur->content);
 
                         mx_close_message (&msg);
+
+                        if (cur->content->parts)
+                                mx_cache_header (ctx, cur);
                 }
         } while (0);
 
@@ -1573,25 +1626,27 @@ static int count_body_parts (BODY *body, int flags)
 
 int mutt_count_body_parts (CONTEXT *ctx, HEADER *hdr)
 {
-        short keep_parts = 0;
-
         if (hdr->attach_valid)
                 return hdr->attach_total;
 
-        if (hdr->content->parts)
-                keep_parts = 1;
-        else
+/* the parsed structure is kept, so later views need not parse it again */
+        if (!hdr->content->parts)
                 mutt_parse_mime_message (ctx, hdr);
 
+        mutt_set_attach_count (hdr, hdr->content);
+
+        return hdr->attach_total;
+}
+
+
+/* count the attachments of a message from a MIME structure, which may
+ * come from somewhere other than the message itself (IMAP BODYSTRUCTURE) */
+void mutt_set_attach_count (HEADER *hdr, BODY *b)
+{
         if (AttachAllow || AttachExclude || InlineAllow || InlineExclude)
-                hdr->attach_total = count_body_parts(hdr->content, M_PARTS_TOPLEVEL);
+                hdr->attach_total = count_body_parts(b, M_PARTS_TOPLEVEL);
         else
                 hdr->attach_total = 0;
 
         hdr->attach_valid = 1;
-
-        if (!keep_parts)
-                mutt_free_body (&hdr->content->parts);
-
-        return hdr->attach_total;
 }
@@ -146,6 +146,33 @@ int mutt_which_case (const char *s)
 }
 
 
+/*
+ * Search lng bytes of mapped message data the way msg_search() reads
+ * msg->fp: in chunks of at most blen - 2 bytes, each ending at a
+ * newline where possible.
+ */
+static int msg_search_data (pattern_t *pat, const char *p, size_t avail, long lng,
+char *buf, size_t blen)
+{
+        const char *nl;
+        size_t n;
+
+        while (lng > 0 && avail) {
+                n = MIN (avail, blen - 2);
+                if ((nl = memchr (p, '\n', n)))
+                        n = nl - p + 1;
+                memcpy (buf, p, n);
+                buf[n] = 0;
+                if (patmatch (pat, buf) == 0)
+                        return 1;
+                lng -= mutt_strlen (buf);
+                p += n;
+                avail -= n;
+        }
+        return 0;
+}
+
+
 static int
 msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
 {
@@ -158,7 +185,8 @@ msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
         int match = 0;
         HEADER *h = ctx->hdrs[msgno];
         char *buf;
-        size_t blen;
+        size_t blen, avail;
+        const char *data = NULL;
 
         if ((msg = mx_open_message (ctx, msgno)) != NULL) {
                 if (option (OPTTHOROUGHSRC)) {
@@ -209,25 +237,30 @@ msg_search (CONTEXT *ctx, pattern_t* pat, int msgno)
                                 if (pat->op == M_BODY)
                                         fseeko (fp, h->content->offset, 0);
                                 lng += h->content->length;
+                                data = mx_message_data (msg, ftello (fp), &avail);
                         }
                 }
 
                 blen = STRING;
                 buf = safe_malloc (blen);
 
-/* search the file "fp" */
-                while (lng > 0) {
-                        if (pat->op == M_HEADER) {
-                                if (*(buf = mutt_read_rfc822_line (fp, buf, &blen)) == '\0')
+/* search the mapped message, or else the file "fp" */
+                if (data)
+                        match = msg_search_data (pat, data, avail, lng, buf, blen);
+                else {
+                        while (lng > 0) {
+                                if (pat->op == M_HEADER) {
+                                        if (*(buf = mutt_read_rfc822_line (fp, buf, &blen)) == '\0')
+                                                break;
+                                }
+                                else if (fgets (buf, blen - 1, fp) == NULL)
+                                        break;            /* don't loop forever */
+                                if (patmatch (pat, buf) == 0) {
+                                        match = 1;
                                         break;
+                                }
+                                lng -= mutt_strlen (buf);
                         }
-                        else if (fgets (buf, blen - 1, fp) == NULL)
-                                break;            /* don't loop forever */
-                        if (patmatch (pat, buf) == 0) {
-                                match = 1;
-                                break;
-                        }
-                        lng -= mutt_strlen (buf);
                 }
 
                 FREE (&buf);
@@ -286,7 +319,7 @@ static int eat_regexp (pattern_t *pat, BUFFER *s, BUFFER *err)
                         FREE (&pat->p.rx);
                         return (-1);
                 }
-                FREE (&buf.data);
+                pat->rxsrc = buf.data;
         }
 
         return 0;
@@ -722,6 +755,7 @@ void mutt_pattern_free (pattern_t **pat)
                         regfree (tmp->p.rx);
                         FREE (&tmp->p.rx);
                 }
+                FREE (&tmp->rxsrc);
 
                 if (tmp->child)
                         mutt_pattern_free (&tmp->child);
@@ -1173,6 +1207,122 @@ mutt_pattern_exec (struct pattern_t *pat, pattern_exec_flag flags, CONTEXT *ctx,
 }
 
 
+/* Return true if A and B are the same pattern, not looking at the
+ * patterns following them. */
+int mutt_pattern_equal (struct pattern_t *a, struct pattern_t *b)
+{
+        if (a->op != b->op || a->not != b->not || a->alladdr != b->alladdr
+                || a->stringmatch != b->stringmatch || a->groupmatch != b->groupmatch
+                || a->ign_case != b->ign_case || a->min != b->min || a->max != b->max)
+                return 0;
+
+        if (a->stringmatch) {
+                if (mutt_strcmp (a->p.str, b->p.str))
+                        return 0;
+        }
+        else if (a->groupmatch) {
+                if (a->p.g != b->p.g)
+                        return 0;
+        }
+        else if (a->p.rx != b->p.rx && (!a->p.rx || !b->p.rx
+                || mutt_strcmp (a->rxsrc, b->rxsrc)))
+                return 0;
+
+        for (a = a->child, b = b->child; a && b; a = a->next, b = b->next)
+                if (!mutt_pattern_equal (a, b))
+                        return 0;
+
+        return a == b;
+}
+
+
+/* Return the M_DEP_* bits naming what the result of PAT may change
+ * with, so that cached results only need re-evaluating when one of
+ * those changes. */
+int mutt_pattern_deps (struct pattern_t *pat)
+{
+        int deps = 0;
+
+        for (; pat; pat = pat->next) {
+                switch (pat->op) {
+                        case M_AND:
+                        case M_OR:
+                                deps |= mutt_pattern_deps (pat->child);
+                                break;
+                        case M_THREAD:
+                                deps |= mutt_pattern_deps (pat->child) | M_DEP_THREAD;
+                                break;
+                        case M_ALL:
+                                break;
+                        case M_EXPIRED:
+                        case M_SUPERSEDED:
+                                deps |= M_DEP_EXPIRED;
+                                break;
+                        case M_FLAG:
+                                deps |= M_DEP_FLAGGED;
+                                break;
+                        case M_TAG:
+                                deps |= M_DEP_TAGGED;
+                                break;
+                        case M_NEW:
+                        case M_UNREAD:
+                        case M_OLD:
+                        case M_READ:
+                                deps |= M_DEP_READ;
+                                break;
+                        case M_REPLIED:
+                                deps |= M_DEP_REPLIED;
+                                break;
+                        case M_DELETED:
+                                deps |= M_DEP_DELETED;
+                                break;
+                        case M_MESSAGE:
+                                deps |= M_DEP_POSITION;
+                                break;
+                        case M_DATE:
+                        case M_DATE_RECEIVED:
+                        case M_SIZE:
+                                deps |= M_DEP_HEADER;
+                                break;
+                        case M_BODY:
+                        case M_HEADER:
+                        case M_WHOLE_MSG:
+                        case M_MIMEATTACH:
+                                deps |= M_DEP_CONTENT;
+                                break;
+                        case M_SCORE:
+                                deps |= M_DEP_SCORE;
+                                break;
+                        case M_CRYPT_SIGN:
+                        case M_CRYPT_VERIFIED:
+                        case M_CRYPT_ENCRYPT:
+                        case M_PGP_KEY:
+                                deps |= M_DEP_SECURITY;
+                                break;
+                        case M_COLLAPSED:
+                        case M_DUPLICATED:
+                        case M_UNREFERENCED:
+                                deps |= M_DEP_THREAD;
+                                break;
+                        case M_LIST:
+                        case M_SUBSCRIBED_LIST:
+                        case M_PERSONAL_RECIP:
+                        case M_PERSONAL_FROM:
+                                deps |= M_DEP_CONFIG | M_DEP_ENVELOPE;
+                                break;
+                        default:
+                                deps |= M_DEP_ENVELOPE;
+                                break;
+                }
+                /* the members of a group can change under the pattern */
+                if (pat->groupmatch)
+                        deps |= M_DEP_CONFIG;
+        }
+
+        return deps;
+}
+
+
 static void quote_simple(char *tmp, size_t len, const char *p)
 {
         int i = 0;
@@ -1238,12 +1388,26 @@ void mutt_check_simple (char *s, size_t len, const char *simple)
 }
 
 
+/* match a message against the pattern given to mutt_pattern_func,
+ * trusting whatever the server already decided for it */
+static int pattern_match (pattern_t *pat, HEADER *h, int serversearch)
+{
+#ifdef USE_IMAP
+        if (serversearch == M_IMAP_SEARCH_EXACT ||
+                (serversearch == M_IMAP_SEARCH_CANDIDATES && !h->matched))
+                return h->matched;
+#endif
+        return mutt_pattern_exec (pat, M_MATCH_FULL_ADDRESS, Context, h);
+}
+
+
 int mutt_pattern_func (int op, char *prompt)
 {
         pattern_t *pat;
         char buf[LONG_STRING] = "", *simple;
         BUFFER err;
         int i;
+        int serversearch = 0;
         progress_t progress;
 
         strfcpy (buf, NONULL (Context->pattern), sizeof (buf));
@@ -1266,7 +1430,8 @@ int mutt_pattern_func (int op, char *prompt)
         }
 
 #ifdef USE_IMAP
-        if (Context->magic == M_IMAP && imap_search (Context, pat) < 0)
+        if (Context->magic == M_IMAP &&
+                (serversearch = imap_search (Context, pat)) < 0)
                 return -1;
 #endif
 
@@ -1288,7 +1453,7 @@ int mutt_pattern_func (int op, char *prompt)
                         Context->hdrs[i]->limited = 0;
                         Context->hdrs[i]->collapsed = 0;
                         Context->hdrs[i]->num_hidden = 0;
-                        if (mutt_pattern_exec (pat, M_MATCH_FULL_ADDRESS, Context, Context->hdrs[i])) {
+                        if (pattern_match (pat, Context->hdrs[i], serversearch)) {
                                 Context->hdrs[i]->virtual = Context->vcount;
                                 Context->hdrs[i]->limited = 1;
                                 Context->v2r[Context->vcount] = i;
@@ -1301,7 +1466,7 @@ int mutt_pattern_func (int op, char *prompt)
         else {
                 for (i = 0; i < Context->vcount; i++) {
                         mutt_progress_update (&progress, i, -1);
-                        if (mutt_pattern_exec (pat, M_MATCH_FULL_ADDRESS, Context, Context->hdrs[Context->v2r[i]])) {
+                        if (pattern_match (pat, Context->hdrs[Context->v2r[i]], serversearch)) {
                                 switch (op) {
                                         case M_DELETE:
                                         case M_UNDELETE:
@@ -1397,8 +1562,19 @@ int mutt_search_command (int cur, int op)
                 for (i = 0; i < Context->msgcount; i++)
                         Context->hdrs[i]->searched = 0;
 #ifdef USE_IMAP
-                if (Context->magic == M_IMAP && imap_search (Context, SearchPattern) < 0)
-                        return -1;
+                if (Context->magic == M_IMAP) {
+                        int serversearch;
+
+                        if ((serversearch = imap_search (Context, SearchPattern)) < 0)
+                                return -1;
+/* the server already settled these, see pattern_match */
+                        if (serversearch == M_IMAP_SEARCH_EXACT ||
+                                serversearch == M_IMAP_SEARCH_CANDIDATES)
+                                for (i = 0; i < Context->msgcount; i++)
+                                        if (serversearch == M_IMAP_SEARCH_EXACT ||
+                                                !Context->hdrs[i]->matched)
+                                                Context->hdrs[i]->searched = 1;
+                }
 #endif
                 unset_option (OPTSEARCHINVALID);
         }
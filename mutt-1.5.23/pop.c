@@ -53,66 +53,188 @@ static int fetch_message (char *line, void *file)
 }
 
 
+/* sizes of all messages, from a single LIST */
+struct pop_list_t
+{
+        long *size;
+        int count;
+};
+
+/* parse LIST */
+static int fetch_list (char *line, void *data)
+{
+        struct pop_list_t *list = (struct pop_list_t *)data;
+        int index;
+        long length;
+
+        if (sscanf (line, "%d %ld", &index, &length) == 2 &&
+                index > 0 && index <= list->count)
+                list->size[index - 1] = length;
+
+        return 0;
+}
+
+
+/* scratch file the header of one message is collected in */
+struct pop_header_t
+{
+        FILE *fp;
+        long lines;
+};
+
+/* write header line to file */
+static int fetch_header (char *line, void *data)
+{
+        struct pop_header_t *hdr = (struct pop_header_t *)data;
+
+        hdr->lines++;
+        return fetch_message (line, hdr->fp);
+}
+
+
 /*
- * Read header
+ * Read the headers of all messages in ctx->hdrs[first..last-1] which do
+ * not have an envelope yet.  The sizes are taken from one LIST for the
+ * whole mailbox, and if the server allows PIPELINING a window of TOP
+ * commands is kept in flight instead of waiting for every reply.
+ * *failed is set to the first message whose header could not be read.
  * returns:
  *  0 on success
  * -1 - connection lost,
  * -2 - invalid command or execution error,
  * -3 - error writing to tempfile
  */
-static int pop_read_header (POP_DATA *pop_data, HEADER *h)
+static int pop_read_headers (CONTEXT *ctx, int first, int last, int *failed,
+progress_t *progress, int done)
 {
-        FILE *f;
-        int ret, index;
-        long length;
+        POP_DATA *pop_data = (POP_DATA *)ctx->data;
+        struct pop_list_t list;
+        struct pop_header_t hdr;
         char buf[LONG_STRING];
-        char tempfile[_POSIX_PATH_MAX];
+        char errmsg[POP_CMD_RESPONSE];
+        BUFFER *cmd = NULL;
+        HEADER *h;
+        int *todo;
+        int i, n = 0, sent = 0, recv = 0, depth;
+        int ret = 0, rc;
+
+        *failed = last;
+
+        todo = safe_malloc ((last - first) * sizeof (int));
+        list.count = 0;
+        for (i = first; i < last; i++) {
+                if (ctx->hdrs[i]->env)
+                        continue;
+                todo[n++] = i;
+                if (ctx->hdrs[i]->refno > list.count)
+                        list.count = ctx->hdrs[i]->refno;
+        }
+        if (!n) {
+                FREE (&todo);
+                return 0;
+        }
 
-        mutt_mktemp (tempfile, sizeof (tempfile));
-        if (!(f = safe_fopen (tempfile, "w+"))) {
-                mutt_perror (tempfile);
-                return -3;
+        hdr.fp = NULL;
+        list.size = safe_calloc (list.count, sizeof (long));
+        ret = pop_fetch_data (pop_data, "LIST\r\n", NULL, fetch_list, &list);
+        if (ret < 0) {
+                *failed = todo[0];
+                goto out;
         }
 
-        snprintf (buf, sizeof (buf), "LIST %d\r\n", h->refno);
-        ret = pop_query (pop_data, buf, sizeof (buf));
-        if (ret == 0) {
-                sscanf (buf, "+OK %d %ld", &index, &length);
+        mutt_mktemp (buf, sizeof (buf));
+        if (!(hdr.fp = safe_fopen (buf, "w+"))) {
+                mutt_perror (buf);
+                *failed = todo[0];
+                ret = -3;
+                goto out;
+        }
+        unlink (buf);
+
+        cmd = mutt_buffer_new ();
+
+        while (recv < sent || (sent < n && ret == 0)) {
+/* top up the window; if TOP has not been seen to work yet, it is
+ * probed with a single command first */
+                depth = (pop_data->pipelining && pop_data->cmd_top == 1) ?
+                        POP_PIPELINE_DEPTH : 1;
+                if (ret == 0 && sent < n && sent - recv <= depth / 2) {
+                        cmd->dptr = cmd->data;
+                        while (sent < n && sent - recv < depth)
+                                mutt_buffer_printf (cmd, "TOP %d 0\r\n", ctx->hdrs[todo[sent++]]->refno);
+                        if (mutt_socket_write (pop_data->conn, cmd->data) < 0) {
+                                pop_data->status = POP_DISCONNECTED;
+                                *failed = todo[recv];
+                                ret = -1;
+                                goto out;
+                        }
+                }
 
-                snprintf (buf, sizeof (buf), "TOP %d 0\r\n", h->refno);
-                ret = pop_fetch_data (pop_data, buf, NULL, fetch_message, f);
+                h = ctx->hdrs[todo[recv]];
+                strfcpy (pop_data->err_msg, "TOP: ", sizeof (pop_data->err_msg));
+                rc = pop_read_status (pop_data, buf, sizeof (buf));
+                if (rc == -1) {
+                        if (ret == 0)
+                                *failed = todo[recv];
+                        ret = -1;
+                        goto out;
+                }
 
                 if (pop_data->cmd_top == 2) {
-                        if (ret == 0) {
+                        if (rc == 0) {
                                 pop_data->cmd_top = 1;
 
-                                dprint (1, (debugfile, "pop_read_header: set TOP capability\n"));
+                                dprint (1, (debugfile, "pop_read_headers: set TOP capability\n"));
                         }
 
-                        if (ret == -2) {
+                        if (rc == -2) {
                                 pop_data->cmd_top = 0;
 
-                                dprint (1, (debugfile, "pop_read_header: unset TOP capability\n"));
+                                dprint (1, (debugfile, "pop_read_headers: unset TOP capability\n"));
                                 snprintf (pop_data->err_msg, sizeof (pop_data->err_msg),
                                         _("Command TOP is not supported by server."));
                         }
                 }
-        }
 
-        switch (ret) {
-                case 0:
-                {
-                        rewind (f);
-                        h->env = mutt_read_rfc822_header (f, h, 0, 0);
-                        h->content->length = length - h->content->offset + 1;
-                        rewind (f);
-                        while (!feof (f)) {
-                                h->content->length--;
-                                fgets (buf, sizeof (buf), f);
+                if (rc == 0) {
+                        rewind (hdr.fp);
+                        ftruncate (fileno (hdr.fp), 0);
+                        hdr.lines = 0;
+                        rc = pop_read_data (pop_data, NULL, fetch_header, &hdr);
+                        if (rc == -1) {
+                                if (ret == 0)
+                                        *failed = todo[recv];
+                                ret = -1;
+                                goto out;
+                        }
+                        if (rc == 0 && fflush (hdr.fp) != 0)
+                                rc = -3;
+                }
+
+/* once something went wrong, the replies still in flight are only
+ * drained to keep the connection usable */
+                if (ret == 0) {
+                        if (rc == 0) {
+                                rewind (hdr.fp);
+                                h->env = mutt_read_rfc822_header (hdr.fp, h, 0, 0);
+                                h->content->length = list.size[h->refno - 1] -
+                                        h->content->offset - hdr.lines;
+                                if (progress)
+                                        mutt_progress_update (progress, ++done, -1);
+                        }
+                        else {
+                                ret = rc;
+                                *failed = todo[recv];
+                                strfcpy (errmsg, pop_data->err_msg, sizeof (errmsg));
                         }
-                        break;
                 }
+                recv++;
+        }
+
+        if (ret == -2)
+                strfcpy (pop_data->err_msg, errmsg, sizeof (pop_data->err_msg));
+
+        switch (ret) {
                 case -2:
                 {
                         mutt_error ("%s", pop_data->err_msg);
@@ -125,8 +247,11 @@ static int pop_read_header (POP_DATA *pop_data, HEADER *h)
                 }
         }
 
-        safe_fclose (&f);
-        unlink (tempfile);
+        out:
+        mutt_buffer_free (&cmd);
+        safe_fclose (&hdr.fp);
+        FREE (&list.size);
+        FREE (&todo);
         return ret;
 }
 
@@ -232,8 +357,9 @@ static header_cache_t *pop_hcache_open (POP_DATA *pop_data, const char *path)
  */
 static int pop_fetch_headers (CONTEXT *ctx)
 {
-        int i, ret, old_count, new_count, deleted;
+        int i, ret, old_count, new_count, deleted, done, failed;
         unsigned short hcached = 0, bcached;
+        unsigned char *cached;
         POP_DATA *pop_data = (POP_DATA *)ctx->data;
         progress_t progress;
 
@@ -288,9 +414,8 @@ static int pop_fetch_headers (CONTEXT *ctx)
                         mutt_sleep (2);
                 }
 
-                for (i = old_count; i < new_count; i++) {
-                        if (!ctx->quiet)
-                                mutt_progress_update (&progress, i + 1 - old_count, -1);
+                cached = safe_calloc (new_count - old_count + 1, sizeof (unsigned char));
+                for (i = old_count, done = 0; i < new_count; i++) {
 #if USE_HCACHE
                         if ((data = mutt_hcache_fetch (hc, ctx->hdrs[i]->data, strlen))) {
                                 char *uidl = safe_strdup (ctx->hdrs[i]->data);
@@ -311,19 +436,26 @@ static int pop_fetch_headers (CONTEXT *ctx)
                                 ctx->hdrs[i]->refno = refno;
                                 ctx->hdrs[i]->index = index;
                                 ctx->hdrs[i]->data = uidl;
-                                ret = 0;
-                                hcached = 1;
+                                cached[i - old_count] = 1;
+                                done++;
                         }
-                        else
+
+                        FREE(&data);
 #endif
-                        if ((ret = pop_read_header (pop_data, ctx->hdrs[i])) < 0)
-                                break;
+                }
+
+/* everything not in the hcache is fetched in one go */
+                if (!ctx->quiet)
+                        mutt_progress_update (&progress, done, -1);
+                ret = pop_read_headers (ctx, old_count, new_count, &failed,
+                        ctx->quiet ? NULL : &progress, done);
+
+                for (i = old_count; i < failed; i++) {
+                        if (cached[i - old_count])
+                                hcached = 1;
 #if USE_HCACHE
-                        else {
+                        else
                                 mutt_hcache_store (hc, ctx->hdrs[i]->data, ctx->hdrs[i], 0, strlen, M_GENERATE_UIDVALIDITY);
-                        }
-
-                        FREE(&data);
 #endif
 
 /*
@@ -354,6 +486,7 @@ static int pop_fetch_headers (CONTEXT *ctx)
 
                         ctx->msgcount++;
                 }
+                FREE (&cached);
 
                 if (i > old_count)
                         mx_update_context (ctx, i - old_count);
@@ -594,8 +727,11 @@ int pop_fetch_message (MESSAGE* msg, CONTEXT* ctx, int msgno)
 /* Update the header information.  Previously, we only downloaded a
  * portion of the headers, those required for the main display.
  */
-        if (bcache)
+        if (bcache) {
+/* flush so that the cache records the full size */
+                fflush (msg->fp);
                 mutt_bcache_commit (pop_data->bcache, h->data);
+        }
         else {
                 cache->index = h->index;
                 cache->path = safe_strdup (path);
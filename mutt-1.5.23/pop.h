@@ -33,6 +33,9 @@
 /* maximal length of the server response (RFC1939) */
 #define POP_CMD_RESPONSE 512
 
+/* number of TOP commands in flight when the server allows PIPELINING */
+#define POP_PIPELINE_DEPTH 32
+
 enum
 {
 /* Status */
@@ -68,6 +71,7 @@ typedef struct
         unsigned int cmd_uidl : 2;                /* optional command UIDL */
         unsigned int cmd_top : 2;                 /* optional command TOP */
         unsigned int resp_codes : 1;              /* server supports extended response codes */
+        unsigned int pipelining : 1;              /* server accepts pipelined commands (RFC2449) */
         unsigned int expire : 1;                  /* expire is greater than 0 */
         unsigned int clear_cache : 1;
         size_t size;
@@ -99,7 +103,9 @@ int pop_parse_path (const char *, ACCOUNT *);
 int pop_connect (POP_DATA *);
 int pop_open_connection (POP_DATA *);
 int pop_query_d (POP_DATA *, char *, size_t, char *);
+int pop_read_status (POP_DATA *, char *, size_t);
 int pop_fetch_data (POP_DATA *, char *, progress_t *, int (*funct) (char *, void *), void *);
+int pop_read_data (POP_DATA *, progress_t *, int (*funct) (char *, void *), void *);
 int pop_reconnect (CONTEXT *);
 void pop_logout (CONTEXT *);
 void pop_error (POP_DATA *, char *);
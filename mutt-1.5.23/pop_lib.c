@@ -117,6 +117,9 @@ static int fetch_capa (char *line, void *data)
         else if (!ascii_strncasecmp (line, "TOP", 3))
                 pop_data->cmd_top = 1;
 
+        else if (!ascii_strncasecmp (line, "PIPELINING", 10))
+                pop_data->pipelining = 1;
+
         return 0;
 }
 
@@ -163,6 +166,7 @@ static int pop_capabilities (POP_DATA *pop_data, int mode)
                 pop_data->cmd_uidl = 0;
                 pop_data->cmd_top = 0;
                 pop_data->resp_codes = 0;
+                pop_data->pipelining = 0;
                 pop_data->expire = 1;
                 pop_data->login_delay = 0;
                 FREE (&pop_data->auth_list);
@@ -417,6 +421,17 @@ int pop_query_d (POP_DATA *pop_data, char *buf, size_t buflen, char *msg)
         *c = '\0';
         snprintf (pop_data->err_msg, sizeof (pop_data->err_msg), "%s: ", buf);
 
+        return pop_read_status (pop_data, buf, buflen);
+}
+
+
+/*
+ * Read the status line of a command which has already been sent, e.g.
+ * one of a pipelined batch.  err_msg should hold the command name.
+ * Returned codes are the same as for pop_query_d.
+ */
+int pop_read_status (POP_DATA *pop_data, char *buf, size_t buflen)
+{
         if (mutt_socket_readln (buf, buflen, pop_data->conn) < 0) {
                 pop_data->status = POP_DISCONNECTED;
                 return -1;
@@ -442,17 +457,32 @@ int pop_fetch_data (POP_DATA *pop_data, char *query, progress_t *progressbar,
 int (*funct) (char *, void *), void *data)
 {
         char buf[LONG_STRING];
-        char *inbuf;
-        char *p;
-        int ret, chunk = 0;
-        long pos = 0;
-        size_t lenbuf = 0;
+        int ret;
 
         strfcpy (buf, query, sizeof (buf));
         ret = pop_query (pop_data, buf, sizeof (buf));
         if (ret < 0)
                 return ret;
 
+        return pop_read_data (pop_data, progressbar, funct, data);
+}
+
+
+/*
+ * Read the body of a multi-line response whose +OK status line has
+ * already been read, calling funct(*line, *data) for each line.
+ * Returned codes are the same as for pop_fetch_data.
+ */
+int pop_read_data (POP_DATA *pop_data, progress_t *progressbar,
+int (*funct) (char *, void *), void *data)
+{
+        char buf[LONG_STRING];
+        char *inbuf;
+        char *p;
+        int ret = 0, chunk = 0;
+        long pos = 0;
+        size_t lenbuf = 0;
+
         inbuf = safe_malloc (sizeof (buf));
 
         FOREVER
@@ -158,24 +158,59 @@ char *type, char *filename, int line)
 }
 
 
-static int rfc1524_mailcap_parse (BODY *a,
-char *filename,
-char *type,
-rfc1524_entry *entry,
-int opt)
+/* Every file on $mailcap_path is read once and kept as a list of
+ * records, indexed by their type field.  A file is re-read only when its
+ * modification time or size changes.  Test commands are still run on
+ * every lookup, since their outcome may differ from one call to the next.
+ */
+typedef struct mailcap_record
+{
+        char *data;                               /* the entry, split into fields */
+        char **fields;                            /* fields[0] is the type, NULL terminated */
+        int line;
+        struct mailcap_record *next;              /* next record with the same type */
+} MAILCAP_RECORD;
+
+typedef struct mailcap_file
+{
+        char *path;
+        int exists;
+        time_t mtime;
+        off_t size;
+        MAILCAP_RECORD *records;
+        int nrecords;
+        HASH *types;                              /* type field -> first record */
+        struct mailcap_file *next;
+} MAILCAP_FILE;
+
+static MAILCAP_FILE *MailcapFiles = NULL;
+
+static void mailcap_file_clear (MAILCAP_FILE *mf)
+{
+        int i;
+
+        for (i = 0; i < mf->nrecords; i++) {
+                FREE (&mf->records[i].data);
+                FREE (&mf->records[i].fields);
+        }
+        FREE (&mf->records);
+        mf->nrecords = 0;
+        if (mf->types)
+                hash_destroy (&mf->types, NULL);
+}
+
+
+static void mailcap_file_read (MAILCAP_FILE *mf)
 {
         FILE *fp;
         char *buf = NULL;
         size_t buflen;
         char *ch;
-        char *field;
-        int found = FALSE;
-        int copiousoutput;
-        int composecommand;
-        int editcommand;
-        int printcommand;
-        int btlen;
         int line = 0;
+        int max = 0;
+        int nfields, maxfields;
+        int i;
+        MAILCAP_RECORD *r, *p;
 
 /* rfc1524 mailcap file is of the format:
  * base/type; command; extradefs
@@ -187,146 +222,269 @@ int opt)
  * line wraps with a \ at the end of the line
  * # for comments
  */
+        if ((fp = fopen (mf->path, "r")) == NULL)
+                return;
 
-/* find length of basetype */
-        if ((ch = strchr (type, '/')) == NULL)
-                return FALSE;
-        btlen = ch - type;
-
-        if ((fp = fopen (filename, "r")) != NULL) {
-                while (!found && (buf = mutt_read_line (buf, &buflen, fp, &line, M_CONT)) != NULL) {
+        while ((buf = mutt_read_line (buf, &buflen, fp, &line, M_CONT)) != NULL) {
 /* ignore comments */
-                        if (*buf == '#')
-                                continue;
-                        dprint (2, (debugfile, "mailcap entry: %s\n", buf));
-
-/* check type */
-                        ch = get_field (buf);
-                        if (ascii_strcasecmp (buf, type) &&
-                                (ascii_strncasecmp (buf, type, btlen) ||
-                                                  /* implicit wild */
-                                (buf[btlen] != 0 &&
-                                                  /* wildsubtype */
-                                mutt_strcmp (buf + btlen, "/*"))))
-                                continue;
+                if (*buf == '#')
+                        continue;
+                dprint (2, (debugfile, "mailcap entry: %s\n", buf));
+
+                if (mf->nrecords == max) {
+                        max += 32;
+                        safe_realloc (&mf->records, max * sizeof (MAILCAP_RECORD));
+                }
+                r = &mf->records[mf->nrecords++];
+                memset (r, 0, sizeof (MAILCAP_RECORD));
+                r->data = safe_strdup (buf);
+                r->line = line;
+
+                nfields = 0;
+                maxfields = 0;
+                for (ch = r->data; ch; ch = get_field (ch)) {
+                        if (nfields + 1 >= maxfields) {
+                                maxfields += 8;
+                                safe_realloc (&r->fields, maxfields * sizeof (char *));
+                        }
+                        r->fields[nfields++] = ch;
+                }
+                r->fields[nfields] = NULL;
+        }
+        safe_fclose (&fp);
+        FREE (&buf);
+
+        mf->types = hash_create (mf->nrecords * 2 + 1, 1);
+        for (i = mf->nrecords - 1; i >= 0; i--) {
+                r = &mf->records[i];
+                if ((p = hash_find (mf->types, r->fields[0])) != NULL) {
+                        hash_delete (mf->types, r->fields[0], p, NULL);
+                        r->next = p;
+                }
+                hash_insert (mf->types, r->fields[0], r, 0);
+        }
+}
+
+
+static MAILCAP_FILE *mailcap_file_get (const char *path)
+{
+        MAILCAP_FILE *mf;
+        struct stat st;
+        int exists;
+
+        for (mf = MailcapFiles; mf; mf = mf->next)
+                if (!mutt_strcmp (mf->path, path))
+                        break;
+        if (!mf) {
+                mf = safe_calloc (1, sizeof (MAILCAP_FILE));
+                mf->path = safe_strdup (path);
+                mf->exists = -1;
+                mf->next = MailcapFiles;
+                MailcapFiles = mf;
+        }
+
+        exists = stat (path, &st) == 0;
+        if (exists != mf->exists ||
+                (exists && (st.st_mtime != mf->mtime || st.st_size != mf->size))) {
+                mailcap_file_clear (mf);
+                mf->exists = exists;
+                if (exists) {
+                        mf->mtime = st.st_mtime;
+                        mf->size = st.st_size;
+                        mailcap_file_read (mf);
+                }
+        }
+        return mf;
+}
+
+
+/* checks a single mailcap record against the requested use, filling in
+ * entry if it fits */
+static int rfc1524_mailcap_entry (BODY *a,
+char *filename,
+char *type,
+MAILCAP_RECORD *r,
+rfc1524_entry *entry,
+int opt)
+{
+        char **ch = r->fields + 1;
+        char *field;
+        int line = r->line;
+        int found;
+        int copiousoutput;
+        int composecommand;
+        int editcommand;
+        int printcommand;
 
 /* next field is the viewcommand */
-                        field = ch;
-                        ch = get_field (ch);
-                        if (entry)
-                                entry->command = safe_strdup (field);
+        field = *ch;
+        if (*ch)
+                ch++;
+        if (entry)
+                entry->command = safe_strdup (field);
 
 /* parse the optional fields */
-                        found = TRUE;
-                        copiousoutput = FALSE;
-                        composecommand = FALSE;
-                        editcommand = FALSE;
-                        printcommand = FALSE;
-
-                        while (ch) {
-                                field = ch;
-                                ch = get_field (ch);
-                                dprint (2, (debugfile, "field: %s\n", field));
-
-                                if (!ascii_strcasecmp (field, "needsterminal")) {
-                                        if (entry)
-                                                entry->needsterminal = TRUE;
-                                }
-                                else if (!ascii_strcasecmp (field, "copiousoutput")) {
-                                        copiousoutput = TRUE;
-                                        if (entry)
-                                                entry->copiousoutput = TRUE;
-                                }
-                                else if (!ascii_strncasecmp (field, "composetyped", 12)) {
+        found = TRUE;
+        copiousoutput = FALSE;
+        composecommand = FALSE;
+        editcommand = FALSE;
+        printcommand = FALSE;
+
+        while (*ch) {
+                field = *ch++;
+                dprint (2, (debugfile, "field: %s\n", field));
+
+                if (!ascii_strcasecmp (field, "needsterminal")) {
+                        if (entry)
+                                entry->needsterminal = TRUE;
+                }
+                else if (!ascii_strcasecmp (field, "copiousoutput")) {
+                        copiousoutput = TRUE;
+                        if (entry)
+                                entry->copiousoutput = TRUE;
+                }
+                else if (!ascii_strncasecmp (field, "composetyped", 12)) {
 /* this compare most occur before compose to match correctly */
-                                        if (get_field_text (field + 12, entry ? &entry->composetypecommand : NULL,
-                                                type, filename, line))
-                                                composecommand = TRUE;
-                                }
-                                else if (!ascii_strncasecmp (field, "compose", 7)) {
-                                        if (get_field_text (field + 7, entry ? &entry->composecommand : NULL,
-                                                type, filename, line))
-                                                composecommand = TRUE;
-                                }
-                                else if (!ascii_strncasecmp (field, "print", 5)) {
-                                        if (get_field_text (field + 5, entry ? &entry->printcommand : NULL,
-                                                type, filename, line))
-                                                printcommand = TRUE;
-                                }
-                                else if (!ascii_strncasecmp (field, "edit", 4)) {
-                                        if (get_field_text (field + 4, entry ? &entry->editcommand : NULL,
-                                                type, filename, line))
-                                                editcommand = TRUE;
-                                }
-                                else if (!ascii_strncasecmp (field, "nametemplate", 12)) {
-                                        get_field_text (field + 12, entry ? &entry->nametemplate : NULL,
-                                                type, filename, line);
-                                }
-                                else if (!ascii_strncasecmp (field, "x-convert", 9)) {
-                                        get_field_text (field + 9, entry ? &entry->convert : NULL,
-                                                type, filename, line);
-                                }
-                                else if (!ascii_strncasecmp (field, "test", 4)) {
+                        if (get_field_text (field + 12, entry ? &entry->composetypecommand : NULL,
+                                type, filename, line))
+                                composecommand = TRUE;
+                }
+                else if (!ascii_strncasecmp (field, "compose", 7)) {
+                        if (get_field_text (field + 7, entry ? &entry->composecommand : NULL,
+                                type, filename, line))
+                                composecommand = TRUE;
+                }
+                else if (!ascii_strncasecmp (field, "print", 5)) {
+                        if (get_field_text (field + 5, entry ? &entry->printcommand : NULL,
+                                type, filename, line))
+                                printcommand = TRUE;
+                }
+                else if (!ascii_strncasecmp (field, "edit", 4)) {
+                        if (get_field_text (field + 4, entry ? &entry->editcommand : NULL,
+                                type, filename, line))
+                                editcommand = TRUE;
+                }
+                else if (!ascii_strncasecmp (field, "nametemplate", 12)) {
+                        get_field_text (field + 12, entry ? &entry->nametemplate : NULL,
+                                type, filename, line);
+                }
+                else if (!ascii_strncasecmp (field, "x-convert", 9)) {
+                        get_field_text (field + 9, entry ? &entry->convert : NULL,
+                                type, filename, line);
+                }
+                else if (!ascii_strncasecmp (field, "test", 4)) {
 /* 
  * This routine executes the given test command to determine
  * if this is the right entry.
  */
-                                        char *test_command = NULL;
-                                        size_t len;
-
-                                        if (get_field_text (field + 4, &test_command, type, filename, line)
-                                        && test_command) {
-                                                len = mutt_strlen (test_command) + STRING;
-                                                safe_realloc (&test_command, len);
-                                                rfc1524_expand_command (a, a->filename, type, test_command, len);
-                                                if (mutt_system (test_command)) {
+                        char *test_command = NULL;
+                        size_t len;
+
+                        if (get_field_text (field + 4, &test_command, type, filename, line)
+                        && test_command) {
+                                len = mutt_strlen (test_command) + STRING;
+                                safe_realloc (&test_command, len);
+                                rfc1524_expand_command (a, a->filename, type, test_command, len);
+                                if (mutt_system (test_command)) {
 /* a non-zero exit code means test failed */
-                                                        found = FALSE;
-                                                }
-                                                FREE (&test_command);
-                                        }
-                                }
-                        }                         /* while (ch) */
-
-                        if (opt == M_AUTOVIEW) {
-                                if (!copiousoutput)
-                                        found = FALSE;
-                        }
-                        else if (opt == M_COMPOSE) {
-                                if (!composecommand)
-                                        found = FALSE;
-                        }
-                        else if (opt == M_EDIT) {
-                                if (!editcommand)
-                                        found = FALSE;
-                        }
-                        else if (opt == M_PRINT) {
-                                if (!printcommand)
                                         found = FALSE;
+                                }
+                                FREE (&test_command);
                         }
+                }
+        }                                         /* while (*ch) */
+
+        if (opt == M_AUTOVIEW) {
+                if (!copiousoutput)
+                        found = FALSE;
+        }
+        else if (opt == M_COMPOSE) {
+                if (!composecommand)
+                        found = FALSE;
+        }
+        else if (opt == M_EDIT) {
+                if (!editcommand)
+                        found = FALSE;
+        }
+        else if (opt == M_PRINT) {
+                if (!printcommand)
+                        found = FALSE;
+        }
 
-                        if (!found) {
+        if (!found) {
 /* reset */
-                                if (entry) {
-                                        FREE (&entry->command);
-                                        FREE (&entry->composecommand);
-                                        FREE (&entry->composetypecommand);
-                                        FREE (&entry->editcommand);
-                                        FREE (&entry->printcommand);
-                                        FREE (&entry->nametemplate);
-                                        FREE (&entry->convert);
-                                        entry->needsterminal = 0;
-                                        entry->copiousoutput = 0;
-                                }
-                        }
-                }                                 /* while (!found && (buf = mutt_read_line ())) */
-                safe_fclose (&fp);
-        }                                         /* if ((fp = fopen ())) */
-        FREE (&buf);
+                if (entry) {
+                        FREE (&entry->command);
+                        FREE (&entry->composecommand);
+                        FREE (&entry->composetypecommand);
+                        FREE (&entry->editcommand);
+                        FREE (&entry->printcommand);
+                        FREE (&entry->nametemplate);
+                        FREE (&entry->convert);
+                        entry->needsterminal = 0;
+                        entry->copiousoutput = 0;
+                }
+        }
         return found;
 }
 
 
+static int rfc1524_mailcap_parse (BODY *a,
+char *filename,
+char *type,
+rfc1524_entry *entry,
+int opt)
+{
+        MAILCAP_FILE *mf;
+        MAILCAP_RECORD *exact, *wild, *base, *r;
+        char key[SHORT_STRING];
+        char *ch;
+        int btlen;
+
+/* find length of basetype */
+        if ((ch = strchr (type, '/')) == NULL)
+                return FALSE;
+        btlen = ch - type;
+
+        mf = mailcap_file_get (filename);
+        if (!mf->types)
+                return FALSE;
+
+/* an entry applies to the full type, to the base type with a wild
+ * subtype, or to the bare base type.  Walk the three chains together so
+ * that entries are still tried in file order. */
+        exact = hash_find (mf->types, type);
+        wild = base = NULL;
+        if (btlen + 3 <= sizeof (key)) {
+                snprintf (key, sizeof (key), "%.*s/*", btlen, type);
+                if (mutt_strcasecmp (key, type))
+                        wild = hash_find (mf->types, key);
+                key[btlen] = 0;
+                base = hash_find (mf->types, key);
+        }
+
+        for (;;) {
+                r = exact;
+                if (wild && (!r || wild < r))
+                        r = wild;
+                if (base && (!r || base < r))
+                        r = base;
+                if (!r)
+                        break;
+                if (r == exact)
+                        exact = exact->next;
+                else if (r == wild)
+                        wild = wild->next;
+                else
+                        base = base->next;
+
+                if (rfc1524_mailcap_entry (a, filename, type, r, entry, opt))
+                        return TRUE;
+        }
+        return FALSE;
+}
+
+
 rfc1524_entry *rfc1524_new_entry(void)
 {
         return (rfc1524_entry *)safe_calloc(1, sizeof(rfc1524_entry));
@@ -65,13 +65,19 @@ char **t, size_t *tlen)
         cd = mutt_iconv_open (to, from, 0);
         if (cd == (iconv_t)(-1))
                 return (size_t)(-1);
+        if (mutt_iconv_is_noop (cd, f, flen)) {
+                mutt_iconv_close (cd);
+                *t = mutt_substrdup (f, f + flen);
+                *tlen = flen;
+                return 0;
+        }
         obl = 4 * flen + 1;
         ob = buf = safe_malloc (obl);
         n = iconv (cd, &f, &flen, &ob, &obl);
         if (n == (size_t)(-1) || iconv (cd, 0, 0, &ob, &obl) == (size_t)(-1)) {
                 e = errno;
                 FREE (&buf);
-                iconv_close (cd);
+                mutt_iconv_close (cd);
                 errno = e;
                 return (size_t)(-1);
         }
@@ -81,7 +87,7 @@ char **t, size_t *tlen)
 
         safe_realloc (&buf, ob - buf + 1);
         *t = buf;
-        iconv_close (cd);
+        mutt_iconv_close (cd);
 
         return n;
 }
@@ -276,11 +282,11 @@ encoder_t *encoder, size_t *wlen)
                 if (iconv (cd, &ib, &ibl, &ob, &obl) == (size_t)(-1) ||
                 iconv (cd, 0, 0, &ob, &obl) == (size_t)(-1)) {
                         assert (errno == E2BIG);
-                        iconv_close (cd);
+                        mutt_iconv_close (cd);
                         assert (ib > d);
                         return (ib - d == dlen) ? dlen : ib - d + 1;
                 }
-                iconv_close (cd);
+                mutt_iconv_close (cd);
         }
         else {
                 if (dlen > sizeof (buf1) - strlen (tocode))
@@ -342,7 +348,7 @@ encoder_t encoder)
                 n1 = iconv (cd, &ib, &ibl, &ob, &obl);
                 n2 = iconv (cd, 0, 0, &ob, &obl);
                 assert (n1 != (size_t)(-1) && n2 != (size_t)(-1));
-                iconv_close (cd);
+                mutt_iconv_close (cd);
                 return (*encoder) (s, buf1, ob - buf1, tocode);
         }
         else
@@ -599,16 +605,21 @@ void rfc2047_encode_adrlist (ADDRESS *addr, const char *tag)
 }
 
 
-static int rfc2047_decode_word (char *d, const char *s, size_t len)
+/*
+ * Decode the encoded word (s, wlen) and convert it to $charset.
+ * Returns the decoded text in a new string, or NULL if the word could
+ * not be decoded.
+ */
+static char *rfc2047_decode_word (const char *s, size_t wlen)
 {
         const char *pp, *pp1;
         char *pd, *d0;
         const char *t, *t1;
         int enc = 0, count = 0;
         char *charset = NULL;
-        int rv = -1;
 
-        pd = d0 = safe_malloc (strlen (s));
+/* the decoded text is never longer than the encoded word */
+        pd = d0 = safe_malloc (wlen + 1);
 
         for (pp = s; (pp1 = strchr (pp, '?')); pp = pp1 + 1) {
                 count++;
@@ -680,12 +691,76 @@ static int rfc2047_decode_word (char *d, const char *s, size_t len)
         if (charset)
                 mutt_convert_string (&d0, charset, Charset, M_ICONV_HOOK_FROM);
         mutt_filter_unprintable (&d0);
-        strfcpy (d, d0, len);
-        rv = 0;
+        FREE (&charset);
+        return d0;
+
         error_out_0:
         FREE (&charset);
         FREE (&d0);
-        return rv;
+        return NULL;
+}
+
+
+/*
+ * Headers of a large folder repeat the same encoded words over and
+ * over (mailing list prefixes, sender names), so decoded words are
+ * kept in a small direct-mapped cache.  Results depend on $charset,
+ * which is checked on every lookup, and on charset-hooks and
+ * iconv-hooks, which flush the cache when they change.
+ */
+#define DECODE_CACHE_SIZE 64
+
+static struct decode_cache_t
+{
+        char *word;                               /* encoded word, not terminated */
+        size_t wlen;
+        char *text;                               /* decoded text */
+} DecodeCache[DECODE_CACHE_SIZE];
+
+static char *DecodeCacheCharset = NULL;
+
+void rfc2047_decode_cache_flush (void)
+{
+        int i;
+
+        for (i = 0; i < DECODE_CACHE_SIZE; i++) {
+                FREE (&DecodeCache[i].word);
+                FREE (&DecodeCache[i].text);
+                DecodeCache[i].wlen = 0;
+        }
+        FREE (&DecodeCacheCharset);
+}
+
+
+static const char *rfc2047_decode_word_cached (const char *s, size_t wlen)
+{
+        struct decode_cache_t *c;
+        unsigned int h = 0;
+        char *text;
+        size_t i;
+
+        if (mutt_strcmp (DecodeCacheCharset, Charset)) {
+                rfc2047_decode_cache_flush ();
+                DecodeCacheCharset = safe_strdup (Charset);
+        }
+
+        for (i = 0; i < wlen; i++)
+                h = h * 33 + (unsigned char) s[i];
+        c = &DecodeCache[h % DECODE_CACHE_SIZE];
+
+        if (c->word && c->wlen == wlen && !memcmp (c->word, s, wlen))
+                return c->text;
+
+        if (!(text = rfc2047_decode_word (s, wlen)))
+                return NULL;
+
+        FREE (&c->word);
+        FREE (&c->text);
+        c->word = safe_malloc (wlen);
+        memcpy (c->word, s, wlen);
+        c->wlen = wlen;
+        c->text = text;
+        return text;
 }
 
 
@@ -764,12 +839,59 @@ static size_t lwsrlen (const char *s, size_t n)
 }
 
 
+/* Returns non-zero if none of the n bytes at s has the high bit set. */
+static int is_us_ascii (const char *s, size_t n)
+{
+        unsigned long w, acc = 0;
+        const char *e = s + n;
+
+        for (; e - s >= sizeof (w); s += sizeof (w)) {
+                memcpy (&w, s, sizeof (w));
+                acc |= w;
+        }
+        for (; s < e; s++)
+                acc |= (unsigned char) *s;
+        return !(acc & (~0UL / 0xff * 0x80));
+}
+
+
+/*
+ * convert_nonmime_string() leaves s unchanged if it is plain us-ascii
+ * and the first $assumed_charset maps us-ascii onto $charset as is.
+ */
+static int nonmime_is_noop (const char *s)
+{
+        char fromcode[SHORT_STRING];
+        const char *c1;
+        size_t n = mutt_strlen (s);
+        iconv_t cd;
+        int rv;
+
+        if (!is_us_ascii (s, n))
+                return 0;
+
+        c1 = strchr (AssumedCharset, ':');
+        if ((c1 ? c1 - AssumedCharset : mutt_strlen (AssumedCharset)) >= sizeof (fromcode))
+                return 0;
+        mutt_substrcpy (fromcode, AssumedCharset,
+                c1 ? c1 : AssumedCharset + mutt_strlen (AssumedCharset), sizeof (fromcode));
+        if (!*fromcode)
+                return 0;
+
+        if ((cd = mutt_iconv_open (Charset, fromcode, 0)) == (iconv_t)(-1))
+                return 0;
+        rv = mutt_iconv_is_noop (cd, s, n);
+        mutt_iconv_close (cd);
+        return rv;
+}
+
+
 /* try to decode anything that looks like a valid RFC2047 encoded
  * header field, ignoring RFC822 parsing rules
  */
 void rfc2047_decode (char **pd)
 {
-        const char *p, *q;
+        const char *p, *q, *t;
         size_t m, n;
         int found_encoded = 0;
         char *d0, *d;
@@ -779,6 +901,11 @@ void rfc2047_decode (char **pd)
         if (!s || !*s)
                 return;
 
+/* Nothing to decode or convert: leave the string alone. */
+        if (!strstr (s, "=?") &&
+                (!AssumedCharset || !*AssumedCharset || nonmime_is_noop (s)))
+                return;
+
         dlen = 4 * strlen (s);                    /* should be enough */
         d = d0 = safe_malloc (dlen + 1);
 
@@ -842,7 +969,9 @@ void rfc2047_decode (char **pd)
                         }
                 }
 
-                if (rfc2047_decode_word (d, p, dlen) == -1) {
+                if ((t = rfc2047_decode_word_cached (p, q - p)))
+                        strfcpy (d, t, dlen);
+                else {
 /* could not decode word, fall back to displaying the raw string */
                         strfcpy(d, p, dlen);
                 }
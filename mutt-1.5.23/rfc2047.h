@@ -27,3 +27,4 @@ void rfc2047_encode_adrlist (ADDRESS *, const char *);
 
 void rfc2047_decode (char **);
 void rfc2047_decode_adrlist (ADDRESS *);
+void rfc2047_decode_cache_flush (void);
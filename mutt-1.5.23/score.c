@@ -25,16 +25,228 @@
 #include <string.h>
 #include <stdlib.h>
 
+/* messages scored together, trying each rule on all of them in turn */
+#define SCORE_BLOCK 64
+
 typedef struct score_t
 {
         char *str;
         pattern_t *pat;
         int val;
         int exact;                                /* if this rule matches, don't evaluate any more */
+        int serial;                               /* identifies the rule in HEADER.score_bits */
+        int column;                               /* where in HEADER.score_bits, -1 if not kept */
+        int *terms;                               /* conjuncts of pat, indices into ScoreTerms */
+        int nterms;
         struct score_t *next;
 } SCORE;
 
 static SCORE *Score = NULL;
+static int ScoreSerial = 0;
+static int ScoreCompiled = 0;
+
+/* The distinct conjuncts of all rules, so that a subpattern shared by
+ * several rules is only evaluated once per message. */
+static pattern_t **ScoreTerms = NULL;
+static int ScoreTermsLen = 0;
+static signed char *ScoreMemo = NULL;
+static int ScoreMemoLen = 0;
+
+/* Rules whose result only depends on the message itself have it kept
+ * in HEADER.score_bits, two bits (known, matched) per rule.  The
+ * columns are renumbered whenever the rules change; ScoreRemap tells
+ * where a column was in the previous layout, so that adding a rule
+ * only evaluates that rule on messages scored before. */
+static int *ScoreColumns = NULL;                  /* serials, by column */
+static int ScoreColumnsLen = 0;
+static int *ScoreRemap = NULL;
+static unsigned int ScoreLayout = 0;
+
+#define SCORE_CACHEABLE (M_DEP_ENVELOPE|M_DEP_HEADER|M_DEP_CONTENT)
+#define SCORE_KNOWN(b,c)   ((b)[(c) / 4] & (1 << (((c) % 4) * 2)))
+#define SCORE_MATCHED(b,c) ((b)[(c) / 4] & (2 << (((c) % 4) * 2)))
+#define SCORE_BYTES(n)     (((n) + 3) / 4)
+
+
+static int score_add_term (pattern_t *pat)
+{
+        int i;
+
+        for (i = 0; i < ScoreTermsLen; i++)
+                if (mutt_pattern_equal (ScoreTerms[i], pat))
+                        return i;
+
+        safe_realloc (&ScoreTerms, (ScoreTermsLen + 1) * sizeof (pattern_t *));
+        ScoreTerms[ScoreTermsLen] = pat;
+        return ScoreTermsLen++;
+}
+
+
+/* Split the rules into shared conjuncts and lay out the cached results
+ * after the rules changed. */
+static void score_compile (void)
+{
+        SCORE *tmp;
+        pattern_t *pat;
+        int *columns = NULL;
+        int i, j, n = 0;
+
+        if (ScoreCompiled)
+                return;
+
+        FREE (&ScoreTerms);
+        ScoreTermsLen = 0;
+
+        for (tmp = Score; tmp; tmp = tmp->next) {
+                FREE (&tmp->terms);
+                tmp->nterms = 0;
+                if (tmp->pat->op == M_AND && !tmp->pat->not)
+                        for (pat = tmp->pat->child; pat; pat = pat->next) {
+                                safe_realloc (&tmp->terms, (tmp->nterms + 1) * sizeof (int));
+                                tmp->terms[tmp->nterms++] = score_add_term (pat);
+                        }
+                else {
+                        tmp->terms = safe_malloc (sizeof (int));
+                        tmp->terms[tmp->nterms++] = score_add_term (tmp->pat);
+                }
+
+                tmp->column = -1;
+                if (!(mutt_pattern_deps (tmp->pat) & ~SCORE_CACHEABLE)) {
+                        safe_realloc (&columns, (n + 1) * sizeof (int));
+                        columns[n] = tmp->serial;
+                        tmp->column = n++;
+                }
+        }
+
+        FREE (&ScoreRemap);
+        if (n)
+                ScoreRemap = safe_malloc (n * sizeof (int));
+        for (i = 0; i < n; i++) {
+                ScoreRemap[i] = -1;
+                for (j = 0; j < ScoreColumnsLen; j++)
+                        if (ScoreColumns[j] == columns[i]) {
+                                ScoreRemap[i] = j;
+                                break;
+                        }
+        }
+        FREE (&ScoreColumns);
+        ScoreColumns = columns;
+        ScoreColumnsLen = n;
+        ScoreLayout++;
+
+        ScoreCompiled = 1;
+}
+
+
+/* Bring the cached results of HDR to the current layout. */
+static void score_sync_bits (HEADER *hdr)
+{
+        unsigned char *bits = NULL;
+        int i, o;
+
+        if (hdr->score_layout == ScoreLayout && (hdr->score_bits || !ScoreColumnsLen))
+                return;
+
+        if (ScoreColumnsLen) {
+                bits = safe_calloc (SCORE_BYTES (ScoreColumnsLen), 1);
+                if (hdr->score_bits && hdr->score_layout == ScoreLayout - 1)
+                        for (i = 0; i < ScoreColumnsLen; i++) {
+                                if ((o = ScoreRemap[i]) < 0 || !SCORE_KNOWN (hdr->score_bits, o))
+                                        continue;
+                                bits[i / 4] |= 1 << ((i % 4) * 2);
+                                if (SCORE_MATCHED (hdr->score_bits, o))
+                                        bits[i / 4] |= 2 << ((i % 4) * 2);
+                        }
+        }
+
+        FREE (&hdr->score_bits);
+        hdr->score_bits = bits;
+        hdr->score_layout = ScoreLayout;
+}
+
+
+/* Does RULE match HDR?  MEMO holds the results of the shared terms
+ * for HDR so far, -1 for those not yet evaluated. */
+static int score_match (SCORE *rule, HEADER *hdr, signed char *memo)
+{
+        int c = rule->column;
+        int i, t, r = 1;
+
+        if (c >= 0 && SCORE_KNOWN (hdr->score_bits, c))
+                return SCORE_MATCHED (hdr->score_bits, c) ? 1 : 0;
+
+        for (i = 0; r && i < rule->nterms; i++) {
+                t = rule->terms[i];
+                if (memo[t] < 0)
+                        memo[t] = mutt_pattern_exec (ScoreTerms[t], 0, NULL, hdr) > 0;
+                r = memo[t];
+        }
+
+        if (c >= 0) {
+                hdr->score_bits[c / 4] |= 1 << ((c % 4) * 2);
+                if (r)
+                        hdr->score_bits[c / 4] |= 2 << ((c % 4) * 2);
+        }
+
+        return r;
+}
+
+
+/* Score the N messages in HDRS, a block at a time.  Within a block
+ * each rule is tried on every message before moving to the next. */
+static void score_headers (CONTEXT *ctx, HEADER **hdrs, int n, int upd_ctx)
+{
+        char done[SCORE_BLOCK];
+        SCORE *tmp;
+        HEADER *hdr;
+        int first, last, i;
+
+        score_compile ();
+
+        if (ScoreMemoLen < SCORE_BLOCK * ScoreTermsLen) {
+                ScoreMemoLen = SCORE_BLOCK * ScoreTermsLen;
+                safe_realloc (&ScoreMemo, ScoreMemoLen);
+        }
+
+        for (first = 0; first < n; first = last) {
+                last = MIN (first + SCORE_BLOCK, n);
+                if (ScoreTermsLen)
+                        memset (ScoreMemo, -1, (last - first) * ScoreTermsLen);
+
+                for (i = first; i < last; i++) {
+                        score_sync_bits (hdrs[i]);
+                        hdrs[i]->score = 0;       /* in case of re-scoring */
+                        done[i - first] = 0;
+                }
+
+                for (tmp = Score; tmp; tmp = tmp->next)
+                for (i = first; i < last; i++) {
+                        hdr = hdrs[i];
+                        if (done[i - first]
+                                || !score_match (tmp, hdr, ScoreMemo + (i - first) * ScoreTermsLen))
+                                continue;
+                        if (tmp->exact || tmp->val == 9999 || tmp->val == -9999) {
+                                hdr->score = tmp->val;
+                                done[i - first] = 1;
+                        }
+                        else
+                                hdr->score += tmp->val;
+                }
+
+                for (i = first; i < last; i++) {
+                        hdr = hdrs[i];
+                        if (hdr->score < 0)
+                                hdr->score = 0;
+
+                        if (hdr->score <= ScoreThresholdDelete)
+                                _mutt_set_flag (ctx, hdr, M_DELETE, 1, upd_ctx);
+                        if (hdr->score <= ScoreThresholdRead)
+                                _mutt_set_flag (ctx, hdr, M_READ, 1, upd_ctx);
+                        if (hdr->score >= ScoreThresholdFlag)
+                                _mutt_set_flag (ctx, hdr, M_FLAG, 1, upd_ctx);
+                }
+        }
+}
 
 void mutt_check_rescore (CONTEXT *ctx)
 {
@@ -52,10 +264,10 @@ void mutt_check_rescore (CONTEXT *ctx)
                 set_option (OPTFORCEREDRAWINDEX);
                 set_option (OPTFORCEREDRAWPAGER);
 
-                for (i = 0; ctx && i < ctx->msgcount; i++) {
-                        mutt_score_message (ctx, ctx->hdrs[i], 1);
+                if (ctx)
+                        mutt_score_messages (ctx, 1);
+                for (i = 0; ctx && i < ctx->msgcount; i++)
                         ctx->hdrs[i]->pair = 0;
-                }
         }
         unset_option (OPTNEEDRESCORE);
 }
@@ -98,6 +310,8 @@ int mutt_parse_score (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
                         Score = ptr;
                 ptr->pat = pat;
                 ptr->str = pattern;
+                ptr->serial = ++ScoreSerial;
+                ScoreCompiled = 0;
         } else
 /* 'buf' arg was cleared and 'pattern' holds the only reference;
  * as here 'ptr' != NULL -> update the value only in which case
@@ -121,27 +335,14 @@ int mutt_parse_score (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 
 void mutt_score_message (CONTEXT *ctx, HEADER *hdr, int upd_ctx)
 {
-        SCORE *tmp;
+        score_headers (ctx, &hdr, 1, upd_ctx);
+}
 
-        hdr->score = 0;                           /* in case of re-scoring */
-        for (tmp = Score; tmp; tmp = tmp->next) {
-                if (mutt_pattern_exec (tmp->pat, 0, NULL, hdr) > 0) {
-                        if (tmp->exact || tmp->val == 9999 || tmp->val == -9999) {
-                                hdr->score = tmp->val;
-                                break;
-                        }
-                        hdr->score += tmp->val;
-                }
-        }
-        if (hdr->score < 0)
-                hdr->score = 0;
-
-        if (hdr->score <= ScoreThresholdDelete)
-                _mutt_set_flag (ctx, hdr, M_DELETE, 1, upd_ctx);
-        if (hdr->score <= ScoreThresholdRead)
-                _mutt_set_flag (ctx, hdr, M_READ, 1, upd_ctx);
-        if (hdr->score >= ScoreThresholdFlag)
-                _mutt_set_flag (ctx, hdr, M_FLAG, 1, upd_ctx);
+
+/* Score every message of CTX. */
+void mutt_score_messages (CONTEXT *ctx, int upd_ctx)
+{
+        score_headers (ctx, ctx->hdrs, ctx->msgcount, upd_ctx);
 }
 
 
@@ -156,6 +357,7 @@ int mutt_parse_unscore (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
                                 last = tmp;
                                 tmp = tmp->next;
                                 mutt_pattern_free (&last->pat);
+                                FREE (&last->terms);
                                 FREE (&last);
                         }
                         Score = NULL;
@@ -168,6 +370,7 @@ int mutt_parse_unscore (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
                                         else
                                                 Score = tmp->next;
                                         mutt_pattern_free (&tmp->pat);
+                                        FREE (&tmp->terms);
                                         FREE (&tmp);
 /* there should only be one score per pattern, so we can stop here */
                                         break;
@@ -175,6 +378,7 @@ int mutt_parse_unscore (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
                         }
                 }
         }
+        ScoreCompiled = 0;
         set_option (OPTNEEDRESCORE);
         return 0;
 }
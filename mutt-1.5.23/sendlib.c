@@ -260,6 +260,63 @@ static void encode_base64 (FGETCONV * fc, FILE *fout, int istext)
 }
 
 
+/* Block encoder for parts that need neither charset conversion nor
+ * CRLF canonicalisation.  Produces exactly what encode_base64() would:
+ * 72 character lines (54 input bytes each), every line terminated by
+ * a newline, and a lone newline for empty input.
+ */
+#define B64_LINE_IN 54
+#define B64_BLOCK_LINES 512
+
+static void encode_base64_block (FILE *fin, FILE *fout)
+{
+        unsigned char in[B64_LINE_IN * B64_BLOCK_LINES];
+        char out[(B64_LINE_IN / 3 * 4 + 1) * B64_BLOCK_LINES];
+        const unsigned char *s;
+        size_t n, r, i, len;
+        char *d;
+        int any = 0;
+
+        do {
+/* Fill the whole block so that only the final read ends mid-line. */
+                for (n = 0; n < sizeof (in); n += r)
+                        if ((r = fread (in + n, 1, sizeof (in) - n, fin)) == 0)
+                                break;
+
+                d = out;
+                for (s = in; s < in + n; s += len) {
+                        len = MIN (B64_LINE_IN, in + n - s);
+                        for (i = 0; i + 3 <= len; i += 3) {
+                                *d++ = B64Chars[s[i] >> 2];
+                                *d++ = B64Chars[((s[i] & 0x3) << 4) | (s[i+1] >> 4)];
+                                *d++ = B64Chars[((s[i+1] & 0xf) << 2) | (s[i+2] >> 6)];
+                                *d++ = B64Chars[s[i+2] & 0x3f];
+                        }
+                        if (len - i == 1) {
+                                *d++ = B64Chars[s[i] >> 2];
+                                *d++ = B64Chars[(s[i] & 0x3) << 4];
+                                *d++ = '=';
+                                *d++ = '=';
+                        }
+                        else if (len - i == 2) {
+                                *d++ = B64Chars[s[i] >> 2];
+                                *d++ = B64Chars[((s[i] & 0x3) << 4) | (s[i+1] >> 4)];
+                                *d++ = B64Chars[(s[i+1] & 0xf) << 2];
+                                *d++ = '=';
+                        }
+                        *d++ = '\n';
+                }
+                if (d > out) {
+                        fwrite (out, 1, d - out, fout);
+                        any = 1;
+                }
+        } while (n == sizeof (in));
+
+        if (!any)
+                fputc ('\n', fout);
+}
+
+
 static void encode_8bit (FGETCONV *fc, FILE *fout, int istext)
 {
         int ch;
@@ -432,6 +489,9 @@ int mutt_write_mime_body (BODY *a, FILE *f)
 
         if (a->encoding == ENCQUOTEDPRINTABLE)
                 encode_quoted (fc, f, write_as_text_part (a));
+        else if (a->encoding == ENCBASE64 && !write_as_text_part (a)
+                && !(a->type == TYPETEXT && !a->noconv))
+                encode_base64_block (fpin, f);
         else if (a->encoding == ENCBASE64)
                 encode_base64 (fc, f, write_as_text_part (a));
         else if (a->type == TYPETEXT && (!a->noconv))
@@ -701,9 +761,9 @@ int *tocode, CONTENT *info)
 
         for (i = 0; i < ncodes; i++)
                 if (cd[i] != (iconv_t)(-1))
-                        iconv_close (cd[i]);
+                        mutt_iconv_close (cd[i]);
 
-        iconv_close (cd1);
+        mutt_iconv_close (cd1);
         FREE (&cd);
         FREE (&infos);
         FREE (&score);
@@ -864,103 +924,157 @@ CONTENT *mutt_get_content_info (const char *fname, BODY *b)
 }
 
 
-/* Given a file with path ``s'', see if there is a registered MIME type.
- * returns the major MIME type, and copies the subtype to ``d''.  First look
- * for ~/.mime.types, then look in a system mime.types if we can find one.
- * The longest match is used so that we can match `ps.gz' when `gz' also
- * exists.
- */
+/* The mime.types files are read once into an index of extensions, which
+ * is rebuilt only when one of the files appears, disappears or changes.
+ * An extension maps to the first entry listing it, in the order the
+ * files are searched. */
+typedef struct mime_ext
+{
+        char *ext;
+        char *type;
+        char *subtype;
+} MIME_EXT;
 
-int mutt_lookup_mime_type (BODY *att, const char *path)
+#define MIME_TYPES_FILES 3
+
+static HASH *MimeExts = NULL;
+static int MimeTypesExists[MIME_TYPES_FILES];
+static time_t MimeTypesMtime[MIME_TYPES_FILES];
+static off_t MimeTypesSize[MIME_TYPES_FILES];
+
+static void mime_ext_free (void *data)
 {
-        FILE *f;
-        char *p, *q, *ct;
-        char buf[LONG_STRING];
-        char subtype[STRING], xtype[STRING];
-        int count;
-        int szf, sze, cur_sze;
-        int type;
+        MIME_EXT *e = data;
 
-        *subtype = '\0';
-        *xtype   = '\0';
-        type     = TYPEOTHER;
-        cur_sze  = 0;
+        FREE (&e->ext);
+        FREE (&e->type);
+        FREE (&e->subtype);
+        FREE (&e);
+}
 
-        szf      = mutt_strlen (path);
 
-        for (count = 0 ; count < 3 ; count++) {
-/*
- * can't use strtok() because we use it in an inner loop below, so use
- * a switch statement here instead.
- */
-                switch (count) {
-                        case 0:
-                                snprintf (buf, sizeof (buf), "%s/.mime.types", NONULL(Homedir));
-                                break;
-                        case 1:
-                                strfcpy (buf, SYSCONFDIR"/mime.types", sizeof(buf));
-                                break;
-                        case 2:
-                                strfcpy (buf, PKGDATADIR"/mime.types", sizeof (buf));
-                                break;
-                        default:
-                                dprint (1, (debugfile, "mutt_lookup_mime_type: Internal error, count = %d.\n", count));
-                                goto bye;         /* shouldn't happen */
-                }
+static void mime_types_path (int count, char *buf, size_t buflen)
+{
+        switch (count) {
+                case 0:
+                        snprintf (buf, buflen, "%s/.mime.types", NONULL(Homedir));
+                        break;
+                case 1:
+                        strfcpy (buf, SYSCONFDIR"/mime.types", buflen);
+                        break;
+                default:
+                        strfcpy (buf, PKGDATADIR"/mime.types", buflen);
+                        break;
+        }
+}
 
-                if ((f = fopen (buf, "r")) != NULL) {
-                        while (fgets (buf, sizeof (buf) - 1, f) != NULL) {
+
+static void mime_types_read (FILE *f)
+{
+        MIME_EXT *e;
+        char *p, *q, *r, *ct;
+        char buf[LONG_STRING];
+
+        while (fgets (buf, sizeof (buf) - 1, f) != NULL) {
 /* weed out any comments */
-                                if ((p = strchr (buf, '#')))
-                                        *p = 0;
+                if ((p = strchr (buf, '#')))
+                        *p = 0;
 
 /* remove any leading space. */
-                                ct = buf;
-                                SKIPWS (ct);
+                ct = buf;
+                SKIPWS (ct);
 
 /* position on the next field in this line */
-                                if ((p = strpbrk (ct, " \t")) == NULL)
-                                        continue;
-                                *p++ = 0;
-                                SKIPWS (p);
+                if ((p = strpbrk (ct, " \t")) == NULL)
+                        continue;
+                *p++ = 0;
+                SKIPWS (p);
 
-/* cycle through the file extensions */
-                                while ((p = strtok (p, " \t\n"))) {
-                                        sze = mutt_strlen (p);
-                                        if ((sze > cur_sze) && (szf >= sze) &&
-                                                (mutt_strcasecmp (path + szf - sze, p) == 0 || ascii_strcasecmp (path + szf - sze, p) == 0) &&
-                                        (szf == sze || path[szf - sze - 1] == '.')) {
-/* get the content-type */
-
-                                                if ((p = strchr (ct, '/')) == NULL) {
 /* malformed line, just skip it. */
-                                                        break;
-                                                }
-                                                *p++ = 0;
+                if ((q = strchr (ct, '/')) == NULL)
+                        continue;
+                for (r = q + 1; *r && !ISSPACE (*r); r++)
+                        ;
 
-                                                for (q = p; *q && !ISSPACE (*q); q++)
-                                                        ;
+/* cycle through the file extensions */
+                while ((p = strtok (p, " \t\n"))) {
+                        if (!hash_find (MimeExts, p)) {
+                                e = safe_calloc (1, sizeof (MIME_EXT));
+                                e->ext = safe_strdup (p);
+                                e->type = mutt_substrdup (ct, q);
+                                e->subtype = mutt_substrdup (q + 1, r);
+                                hash_insert (MimeExts, e->ext, e, 0);
+                        }
+                        p = NULL;
+                }
+        }
+}
 
-                                                mutt_substrcpy (subtype, p, q, sizeof (subtype));
 
-                                                if ((type = mutt_check_mime_type (ct)) == TYPEOTHER)
-                                                        strfcpy (xtype, ct, sizeof (xtype));
+static void mime_types_check (void)
+{
+        FILE *f;
+        char buf[_POSIX_PATH_MAX];
+        struct stat st[MIME_TYPES_FILES];
+        int exists[MIME_TYPES_FILES];
+        int count, changed = !MimeExts;
+
+        for (count = 0; count < MIME_TYPES_FILES; count++) {
+                mime_types_path (count, buf, sizeof (buf));
+                exists[count] = stat (buf, &st[count]) == 0;
+                if (exists[count] != MimeTypesExists[count] ||
+                        (exists[count] && (st[count].st_mtime != MimeTypesMtime[count] ||
+                        st[count].st_size != MimeTypesSize[count])))
+                        changed = 1;
+        }
+        if (!changed)
+                return;
 
-                                                cur_sze = sze;
-                                        }
-                                        p = NULL;
-                                }
-                        }
+        if (MimeExts)
+                hash_destroy (&MimeExts, mime_ext_free);
+        MimeExts = hash_create (1031, 1);
+
+        for (count = 0; count < MIME_TYPES_FILES; count++) {
+                MimeTypesExists[count] = exists[count];
+                if (!exists[count])
+                        continue;
+                MimeTypesMtime[count] = st[count].st_mtime;
+                MimeTypesSize[count] = st[count].st_size;
+
+                mime_types_path (count, buf, sizeof (buf));
+                if ((f = fopen (buf, "r")) != NULL) {
+                        mime_types_read (f);
                         safe_fclose (&f);
                 }
         }
+}
+
+
+/* Given a file with path ``s'', see if there is a registered MIME type.
+ * returns the major MIME type, and copies the subtype to ``d''.  First look
+ * for ~/.mime.types, then look in a system mime.types if we can find one.
+ * The longest match is used so that we can match `ps.gz' when `gz' also
+ * exists.
+ */
+
+int mutt_lookup_mime_type (BODY *att, const char *path)
+{
+        MIME_EXT *e = NULL;
+        const char *p;
+        int type = TYPEOTHER;
+
+        mime_types_check ();
 
-        bye:
+/* the whole name, then the part after each dot: the first hit is the
+ * longest matching extension */
+        for (p = path; p && !e; p = (p = strchr (p, '.')) ? p + 1 : NULL)
+                if (*p)
+                        e = hash_find (MimeExts, p);
 
-        if (type != TYPEOTHER || *xtype != '\0') {
+        if (e && ((type = mutt_check_mime_type (e->type)) != TYPEOTHER || *e->type)) {
                 att->type = type;
-                mutt_str_replace (&att->subtype, subtype);
-                mutt_str_replace (&att->xtype, xtype);
+                mutt_str_replace (&att->subtype, e->subtype);
+                mutt_str_replace (&att->xtype, type == TYPEOTHER ? e->type : "");
         }
 
         return (type);
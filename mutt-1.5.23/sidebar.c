@@ -172,11 +172,143 @@ void set_curbuffy(char buf[LONG_STRING])
 }
 
 
+/* Each mailbox keeps its formatted sidebar line, which is rebuilt only
+ * when its counts change or SidebarSerial moves on because the folder,
+ * width or delimiter changed. */
+static unsigned int SidebarSerial = 1;
+static char *SidebarFolder = NULL;
+static char *SidebarLayoutDelim = NULL;
+static short SidebarLayoutWidth = -1;
+
+static void sidebar_check_layout(void)
+{
+        if ( SidebarLayoutWidth == SidebarWidth &&
+                !mutt_strcmp(SidebarFolder, Maildir) &&
+                !mutt_strcmp(SidebarLayoutDelim, SidebarDelim) )
+                return;
+        mutt_str_replace(&SidebarFolder, Maildir);
+        mutt_str_replace(&SidebarLayoutDelim, SidebarDelim);
+        SidebarLayoutWidth = SidebarWidth;
+        SidebarSerial++;
+}
+
+
+static const char *sidebar_entry(BUFFY *b)
+{
+        if ( b->sb_serial == SidebarSerial && b->sb_entry &&
+                b->sb_msgcount == b->msgcount &&
+                b->sb_unread == b->msg_unread && b->sb_flagged == b->msg_flagged )
+                return b->sb_entry;
+
+        if ( b->sb_serial != SidebarSerial || !b->sb_name ) {
+// check whether Maildir is a prefix of the current folder's path
+                short maildir_is_prefix = 0;
+                if ( (strlen(b->path) > strlen(Maildir)) &&
+                        (strncmp(Maildir, b->path, strlen(Maildir)) == 0) )
+                        maildir_is_prefix = 1;
+// calculate depth of current folder and generate its display name with indented spaces
+                int sidebar_folder_depth = 0;
+                char *sidebar_folder_name;
+                sidebar_folder_name = basename(b->path);
+                if ( maildir_is_prefix ) {
+                        char *tmp_folder_name;
+                        int i;
+                        tmp_folder_name = b->path + strlen(Maildir);
+                        for (i = 0; i < strlen(b->path) - strlen(Maildir); i++) {
+                                if (tmp_folder_name[i] == '/') sidebar_folder_depth++;
+                        }
+                        if (sidebar_folder_depth > 0) {
+                                sidebar_folder_name = malloc(strlen(basename(b->path)) + sidebar_folder_depth + 1);
+                                for (i=0; i < sidebar_folder_depth; i++)
+                                        sidebar_folder_name[i]=' ';
+                                sidebar_folder_name[i]=0;
+                                strncat(sidebar_folder_name, basename(b->path), strlen(basename(b->path)) + sidebar_folder_depth);
+                        }
+                }
+                mutt_str_replace(&b->sb_name, sidebar_folder_name);
+                if (sidebar_folder_depth > 0)
+                        free(sidebar_folder_name);
+        }
+
+        mutt_str_replace(&b->sb_entry, make_sidebar_entry(NONULL(b->sb_name), b->msgcount,
+                b->msg_unread, b->msg_flagged));
+        b->sb_serial = SidebarSerial;
+        b->sb_msgcount = b->msgcount;
+        b->sb_unread = b->msg_unread;
+        b->sb_flagged = b->msg_flagged;
+        return NONULL(b->sb_entry);
+}
+
+
+/* What was last drawn on each sidebar row, so that rows showing the same
+ * mailbox line in the same colour are left alone.  The records are reset
+ * whenever the screen is cleared or the sidebar layout changes. */
+typedef struct sidebar_row
+{
+        char *entry;
+        int attr;
+        int drawn;                                /* entry is on the screen */
+        int divider;                              /* divider is on the screen */
+} SIDEBAR_ROW;
+
+static SIDEBAR_ROW *SidebarRows = NULL;
+static int SidebarRowCount = 0;
+static unsigned int SidebarRowsScreen;
+static unsigned int SidebarRowsLayout;
+static short SidebarRowsDivider;
+
+static void sidebar_check_rows(short divider)
+{
+        int i;
+
+        sidebar_check_layout();
+        if ( SidebarRows && SidebarRowCount == LINES && SidebarRowsScreen == ScreenSerial &&
+                SidebarRowsLayout == SidebarSerial && SidebarRowsDivider == divider )
+                return;
+
+        for (i = 0; i < SidebarRowCount; i++)
+                FREE(&SidebarRows[i].entry);
+        SidebarRowCount = LINES;
+        safe_realloc(&SidebarRows, SidebarRowCount * sizeof(SIDEBAR_ROW));
+        memset(SidebarRows, 0, SidebarRowCount * sizeof(SIDEBAR_ROW));
+        SidebarRowsScreen = ScreenSerial;
+        SidebarRowsLayout = SidebarSerial;
+        SidebarRowsDivider = divider;
+}
+
+
+/* The status and help lines are drawn across the sidebar on the first
+ * and last of its rows, and long pager lines may wrap into it, so those
+ * are always redrawn. */
+static int sidebar_row_exposed(int menu, int line)
+{
+        return menu == MENU_PAGER || line == 0 || line == LINES - 2;
+}
+
+
+/* returns 1 if the row must be drawn, and records what it will show */
+static int sidebar_row_changed(int menu, int line, const char *entry, int attr)
+{
+        SIDEBAR_ROW *row = &SidebarRows[line];
+
+        if ( row->drawn && row->attr == attr && !mutt_strcmp(row->entry, entry) &&
+                !sidebar_row_exposed(menu, line) )
+                return 0;
+        mutt_str_replace(&row->entry, entry);
+        row->attr = attr;
+        row->drawn = 1;
+        return 1;
+}
+
+
 int draw_sidebar(int menu)
 {
 
         int lines = option(OPTHELP) ? 1 : 0;
         BUFFY *tmp;
+        SIDEBAR_ROW *row;
+        const char *entry;
+        int color;
 #ifndef USE_SLANG_CURSES
         attr_t attrs;
 #endif
@@ -246,12 +378,17 @@ int draw_sidebar(int menu)
 
 /* draw the divider */
 
+        sidebar_check_rows(color_pair);
         for ( ; lines < LINES-1-(menu != MENU_PAGER || option(OPTSTATUSONTOP)); lines++ ) {
+                row = &SidebarRows[lines];
+                if ( row->divider && !sidebar_row_exposed(menu, lines) )
+                        continue;
                 move(lines, SidebarWidth - delim_len);
                 addstr(NONULL(SidebarDelim));
 #ifndef USE_SLANG_CURSES
                 mvchgat(lines, SidebarWidth - delim_len, delim_len, 0, color_pair, NULL);
 #endif
+                row->divider = 1;
         }
 
         if ( Incoming == 0 ) return 0;
@@ -267,56 +404,37 @@ int draw_sidebar(int menu)
 
         for ( ; tmp && lines < LINES-1 - (menu != MENU_PAGER || option(OPTSTATUSONTOP)); tmp = tmp->next ) {
                 if (tmp == CurBuffy)
-                        SETCOLOR(MT_COLOR_SB_INDICATOR);
-				else if (strcmp(tmp->path, Spoolfile) == 0) 
-						SETCOLOR(MT_COLOR_SB_SPOOLFILE);
+                        color = MT_COLOR_SB_INDICATOR;
+                else if (strcmp(tmp->path, Spoolfile) == 0)
+                        color = MT_COLOR_SB_SPOOLFILE;
                 else if ( tmp->msg_unread > 0 )
-                        SETCOLOR(MT_COLOR_NEW);
+                        color = MT_COLOR_NEW;
                 else if ( tmp->msg_flagged > 0 )
-                        SETCOLOR(MT_COLOR_FLAGGED);
+                        color = MT_COLOR_FLAGGED;
                 else
-                        SETCOLOR(MT_COLOR_NORMAL);
+                        color = MT_COLOR_NORMAL;
 
-                move( lines, 0 );
                 if ( Context && !strcmp( tmp->path, Context->path ) ) {
                         tmp->msg_unread = Context->unread;
                         tmp->msgcount = Context->msgcount;
                         tmp->msg_flagged = Context->flagged;
                 }
-// check whether Maildir is a prefix of the current folder's path
-                short maildir_is_prefix = 0;
-                if ( (strlen(tmp->path) > strlen(Maildir)) &&
-                        (strncmp(Maildir, tmp->path, strlen(Maildir)) == 0) )
-                        maildir_is_prefix = 1;
-// calculate depth of current folder and generate its display name with indented spaces
-                int sidebar_folder_depth = 0;
-                char *sidebar_folder_name;
-                sidebar_folder_name = basename(tmp->path);
-                if ( maildir_is_prefix ) {
-                        char *tmp_folder_name;
-                        int i;
-                        tmp_folder_name = tmp->path + strlen(Maildir);
-                        for (i = 0; i < strlen(tmp->path) - strlen(Maildir); i++) {
-                                if (tmp_folder_name[i] == '/') sidebar_folder_depth++;
-                        }
-                        if (sidebar_folder_depth > 0) {
-                                sidebar_folder_name = malloc(strlen(basename(tmp->path)) + sidebar_folder_depth + 1);
-                                for (i=0; i < sidebar_folder_depth; i++)
-                                        sidebar_folder_name[i]=' ';
-                                sidebar_folder_name[i]=0;
-                                strncat(sidebar_folder_name, basename(tmp->path), strlen(basename(tmp->path)) + sidebar_folder_depth);
-                        }
+                entry = sidebar_entry(tmp);
+
+                if ( !sidebar_row_changed(menu, lines, entry, ColorDefs[color]) ) {
+                        lines++;
+                        continue;
                 }
-                printw( "%.*s", SidebarWidth - delim_len + 1,
-                        make_sidebar_entry(sidebar_folder_name, tmp->msgcount,
-                        tmp->msg_unread, tmp->msg_flagged));
-                if (sidebar_folder_depth > 0)
-                        free(sidebar_folder_name);
+                SETCOLOR(color);
+                move( lines, 0 );
+                printw( "%.*s", SidebarWidth - delim_len + 1, entry);
                 lines++;
         }
         SETCOLOR(MT_COLOR_NORMAL);
         for ( ; lines < LINES-1 - (menu != MENU_PAGER || option(OPTSTATUSONTOP)); lines++ ) {
                 int i = 0;
+                if ( !sidebar_row_changed(menu, lines, NULL, ColorDefs[MT_COLOR_NORMAL]) )
+                        continue;
                 move( lines, 0 );
                 for ( ; i < SidebarWidth - delim_len; i++ )
                         addch(' ');
@@ -52,6 +52,10 @@
 #define SMTP_PORT 25
 #define SMTPS_PORT 465
 
+/* message data is written in pieces of this size (and as BDAT chunks of
+ * this size if the server supports CHUNKING) */
+#define SMTP_DATA_CHUNK 65536
+
 #define SMTP_AUTH_SUCCESS 0
 #define SMTP_AUTH_UNAVAIL 1
 #define SMTP_AUTH_FAIL    -1
@@ -62,6 +66,8 @@ enum
         AUTH,
         DSN,
         EIGHTBITMIME,
+        PIPELINING,
+        CHUNKING,
 
         CAPMAX
 };
@@ -94,19 +100,17 @@ static int smtp_code (char *buf, size_t len, int *n)
 }
 
 
-/* Reads a command response from the SMTP server.
- * Returns:
- * 0	on success (2xx code) or continue (354 code)
- * -1	write error, or any other response code
+/* Reads a command response from the SMTP server into buf (the last line
+ * of a multi-line response).
+ * Returns the response code, or smtp_err_read/smtp_err_code.
  */
 static int
-smtp_get_resp (CONNECTION * conn)
+smtp_read_resp (CONNECTION * conn, char *buf, size_t buflen)
 {
         int n;
-        char buf[1024];
 
         do {
-                n = mutt_socket_readln (buf, sizeof (buf), conn);
+                n = mutt_socket_readln (buf, buflen, conn);
                 if (n < 4) {
 /* read error, or no response code */
                         return smtp_err_read;
@@ -123,12 +127,34 @@ smtp_get_resp (CONNECTION * conn)
                         mutt_bit_set (Capabilities, DSN);
                 else if (!ascii_strncasecmp ("STARTTLS", buf + 4, 8))
                         mutt_bit_set (Capabilities, STARTTLS);
+                else if (!ascii_strncasecmp ("PIPELINING", buf + 4, 10))
+                        mutt_bit_set (Capabilities, PIPELINING);
+                else if (!ascii_strncasecmp ("CHUNKING", buf + 4, 8))
+                        mutt_bit_set (Capabilities, CHUNKING);
 
                 if (smtp_code (buf, n, &n) < 0)
                         return smtp_err_code;
 
         } while (buf[3] == '-');
 
+        return n;
+}
+
+
+/* Reads a command response from the SMTP server.
+ * Returns:
+ * 0	on success (2xx code) or continue (354 code)
+ * -1	write error, or any other response code
+ */
+static int
+smtp_get_resp (CONNECTION * conn)
+{
+        int n;
+        char buf[1024];
+
+        if ((n = smtp_read_resp (conn, buf, sizeof (buf))) < 0)
+                return n;
+
         if (smtp_success (n) || n == smtp_continue)
                 return 0;
 
@@ -137,28 +163,153 @@ smtp_get_resp (CONNECTION * conn)
 }
 
 
+/* Reads the response to RCPT TO for address a, naming the recipient if it
+ * was refused (and report is set). */
 static int
-smtp_rcpt_to (CONNECTION * conn, const ADDRESS * a)
+smtp_rcpt_resp (CONNECTION * conn, const ADDRESS * a, int report)
 {
+        int n;
         char buf[1024];
-        int r;
 
-        while (a) {
+        if ((n = smtp_read_resp (conn, buf, sizeof (buf))) < 0)
+                return n;
+
+        if (smtp_success (n))
+                return 0;
+
+        dprint (1, (debugfile, "smtp_rcpt_resp: %s refused: %s\n", a->mailbox, buf));
+        if (report)
+                mutt_error (_("SMTP server rejected recipient %s: %s"), a->mailbox, buf);
+        return -1;
+}
+
+
+static void
+smtp_rcpt_cmd (BUFFER * cmd, const ADDRESS * a)
+{
+        if (mutt_bit_isset (Capabilities, DSN) && DsnNotify)
+                mutt_buffer_printf (cmd, "RCPT TO:<%s> NOTIFY=%s\r\n",
+                        a->mailbox, DsnNotify);
+        else
+                mutt_buffer_printf (cmd, "RCPT TO:<%s>\r\n", a->mailbox);
+}
+
+
 /* weed out group mailboxes, since those are for display only */
-                if (!a->mailbox || a->group) {
-                        a = a->next;
+#define smtp_rcpt_skip(a) (!(a)->mailbox || (a)->group)
+
+static int
+smtp_rcpt_to (CONNECTION * conn, const ADDRESS * a)
+{
+        BUFFER *cmd;
+        int r = 0;
+
+        cmd = mutt_buffer_new ();
+        for (; a; a = a->next) {
+                if (smtp_rcpt_skip (a))
                         continue;
+                cmd->dptr = cmd->data;
+                smtp_rcpt_cmd (cmd, a);
+                if (mutt_socket_write (conn, cmd->data) == -1) {
+                        r = smtp_err_write;
+                        break;
                 }
-                if (mutt_bit_isset (Capabilities, DSN) && DsnNotify)
-                        snprintf (buf, sizeof (buf), "RCPT TO:<%s> NOTIFY=%s\r\n",
-                                a->mailbox, DsnNotify);
-                else
-                        snprintf (buf, sizeof (buf), "RCPT TO:<%s>\r\n", a->mailbox);
-                if (mutt_socket_write (conn, buf) == -1)
+                if ((r = smtp_rcpt_resp (conn, a, 1)))
+                        break;
+        }
+        mutt_buffer_free (&cmd);
+
+        return r;
+}
+
+
+/* With PIPELINING (RFC 2920) MAIL FROM and every RCPT TO go out in a
+ * single write, and the replies are matched up with the recipients
+ * afterwards, in order.  DATA is left out of the group so that nothing is
+ * sent when a recipient was refused.
+ */
+static int
+smtp_send_envelope (CONNECTION * conn, const char *mailfrom,
+const ADDRESS * to, const ADDRESS * cc, const ADDRESS * bcc)
+{
+        const ADDRESS *lists[3], *a;
+        BUFFER *cmd;
+        int i, r, rc = 0;
+
+        lists[0] = to;
+        lists[1] = cc;
+        lists[2] = bcc;
+
+        if (!mutt_bit_isset (Capabilities, PIPELINING)) {
+                if (mutt_socket_write (conn, mailfrom) == -1)
                         return smtp_err_write;
                 if ((r = smtp_get_resp (conn)))
                         return r;
-                a = a->next;
+                for (i = 0; i < 3; i++)
+                        if ((r = smtp_rcpt_to (conn, lists[i])))
+                                return r;
+                return 0;
+        }
+
+        cmd = mutt_buffer_new ();
+        mutt_buffer_addstr (cmd, mailfrom);
+        for (i = 0; i < 3; i++)
+                for (a = lists[i]; a; a = a->next)
+                        if (!smtp_rcpt_skip (a))
+                                smtp_rcpt_cmd (cmd, a);
+        r = mutt_socket_write (conn, cmd->data);
+        mutt_buffer_free (&cmd);
+        if (r == -1)
+                return smtp_err_write;
+
+        if ((r = smtp_get_resp (conn)))
+                return r;
+
+/* read every reply, so that the first refused recipient is reported */
+        for (i = 0; i < 3; i++)
+                for (a = lists[i]; a; a = a->next) {
+                        if (smtp_rcpt_skip (a))
+                                continue;
+                        if ((r = smtp_rcpt_resp (conn, a, !rc)) < -1)
+                                return r;
+                        if (r && !rc)
+                                rc = r;
+                }
+
+        return rc;
+}
+
+
+/* Writes out len bytes of message data from buf, which must have room
+ * for a terminating NUL.  If the server supports CHUNKING (RFC 3030) the
+ * data goes out as a BDAT chunk; with PIPELINING the replies to the
+ * chunks are only collected after the last one.
+ */
+static int
+smtp_write_data (CONNECTION * conn, char *buf, size_t len, int bdat,
+int last, int *pending)
+{
+        char cmd[STRING];
+        int r;
+
+        if (bdat) {
+                snprintf (cmd, sizeof (cmd), "BDAT %lu%s\r\n", (unsigned long) len,
+                        last ? " LAST" : "");
+                if (mutt_socket_write (conn, cmd) == -1)
+                        return smtp_err_write;
+                (*pending)++;
+        }
+
+        buf[len] = '\0';
+        if (len && mutt_socket_write_d (conn, buf, len, M_SOCK_LOG_FULL) == -1)
+                return smtp_err_write;
+
+        if (bdat && (last || !mutt_bit_isset (Capabilities, PIPELINING))) {
+                while (*pending > 0) {
+                        (*pending)--;
+                        if ((r = smtp_get_resp (conn)))
+                                return r;
+                }
         }
 
         return 0;
@@ -169,11 +320,13 @@ static int
 smtp_data (CONNECTION * conn, const char *msgfile)
 {
         char buf[1024];
+        char *out = NULL;
         FILE *fp = 0;
         progress_t progress;
         struct stat st;
-        int r, term = 0;
-        size_t buflen = 0;
+        int r = 0, term = 0, bol = 1, pending = 0;
+        int bdat = mutt_bit_isset (Capabilities, CHUNKING);
+        size_t buflen = 0, outlen = 0;
 
         fp = fopen (msgfile, "r");
         if (!fp) {
@@ -185,49 +338,64 @@ smtp_data (CONNECTION * conn, const char *msgfile)
         mutt_progress_init (&progress, _("Sending message..."), M_PROGRESS_SIZE,
                 NetInc, st.st_size);
 
-        snprintf (buf, sizeof (buf), "DATA\r\n");
-        if (mutt_socket_write (conn, buf) == -1) {
-                safe_fclose (&fp);
-                return smtp_err_write;
-        }
-        if ((r = smtp_get_resp (conn))) {
-                safe_fclose (&fp);
-                return r;
+        if (!bdat) {
+                snprintf (buf, sizeof (buf), "DATA\r\n");
+                if (mutt_socket_write (conn, buf) == -1) {
+                        safe_fclose (&fp);
+                        return smtp_err_write;
+                }
+                if ((r = smtp_get_resp (conn))) {
+                        safe_fclose (&fp);
+                        return r;
+                }
         }
 
+/* room for a full line, its dot-stuffing and the terminating ".\r\n" */
+        out = safe_malloc (SMTP_DATA_CHUNK + sizeof (buf) + 8);
+
         while (fgets (buf, sizeof (buf) - 1, fp)) {
                 buflen = mutt_strlen (buf);
                 term = buf[buflen-1] == '\n';
                 if (buflen && buf[buflen-1] == '\n'
                         && (buflen == 1 || buf[buflen - 2] != '\r'))
                         snprintf (buf + buflen - 1, sizeof (buf) - buflen + 1, "\r\n");
-                if (buf[0] == '.') {
-                        if (mutt_socket_write_d (conn, ".", -1, M_SOCK_LOG_FULL) == -1) {
-                                safe_fclose (&fp);
-                                return smtp_err_write;
-                        }
-                }
-                if (mutt_socket_write_d (conn, buf, -1, M_SOCK_LOG_FULL) == -1) {
-                        safe_fclose (&fp);
-                        return smtp_err_write;
+                buflen = mutt_strlen (buf);
+
+                if (outlen + buflen + 1 > SMTP_DATA_CHUNK) {
+                        if ((r = smtp_write_data (conn, out, outlen, bdat, 0, &pending)))
+                                goto out;
+                        outlen = 0;
+                        mutt_progress_update (&progress, ftell (fp), -1);
                 }
-                mutt_progress_update (&progress, ftell (fp), -1);
+
+                if (bol && !bdat && buf[0] == '.')
+                        out[outlen++] = '.';
+                memcpy (out + outlen, buf, buflen);
+                outlen += buflen;
+                bol = term;
         }
-        if (!term && buflen &&
-        mutt_socket_write_d (conn, "\r\n", -1, M_SOCK_LOG_FULL) == -1) {
-                safe_fclose (&fp);
-                return smtp_err_write;
+        if (!term && buflen) {
+                memcpy (out + outlen, "\r\n", 2);
+                outlen += 2;
         }
-        safe_fclose (&fp);
 
 /* terminate the message body */
-        if (mutt_socket_write (conn, ".\r\n") == -1)
-                return smtp_err_write;
+        if (!bdat) {
+                memcpy (out + outlen, ".\r\n", 3);
+                outlen += 3;
+        }
 
-        if ((r = smtp_get_resp (conn)))
-                return r;
+        if ((r = smtp_write_data (conn, out, outlen, bdat, 1, &pending)))
+                goto out;
+        mutt_progress_update (&progress, st.st_size, -1);
 
-        return 0;
+        if (!bdat)
+                r = smtp_get_resp (conn);
+
+        out:
+        FREE (&out);
+        safe_fclose (&fp);
+        return r;
 }
 
 
@@ -275,16 +443,9 @@ const ADDRESS* bcc, const char *msgfile, int eightbit)
                 if (DsnReturn && mutt_bit_isset (Capabilities, DSN))
                         ret += snprintf (buf + ret, sizeof (buf) - ret, " RET=%s", DsnReturn);
                 safe_strncat (buf, sizeof (buf), "\r\n", 3);
-                if (mutt_socket_write (conn, buf) == -1) {
-                        ret = smtp_err_write;
-                        break;
-                }
-                if ((ret = smtp_get_resp (conn)))
-                        break;
 
-/* send the recipient list */
-                if ((ret = smtp_rcpt_to (conn, to)) || (ret = smtp_rcpt_to (conn, cc))
-                        || (ret = smtp_rcpt_to (conn, bcc)))
+/* send the sender's address and the recipient list */
+                if ((ret = smtp_send_envelope (conn, buf, to, cc, bcc)))
                         break;
 
 /* send the message data */
@@ -268,10 +268,8 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
         if (!ctx->quiet)
                 mutt_message _("Sorting mailbox...");
 
-        if (option (OPTNEEDRESCORE) && option (OPTSCORE)) {
-                for (i = 0; i < ctx->msgcount; i++)
-                        mutt_score_message (ctx, ctx->hdrs[i], 1);
-        }
+        if (option (OPTNEEDRESCORE) && option (OPTSCORE))
+                mutt_score_messages (ctx, 1);
         unset_option (OPTNEEDRESCORE);
 
         if (option (OPTRESORTINIT)) {
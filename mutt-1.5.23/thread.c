@@ -114,19 +114,17 @@ static void linearize_tree (CONTEXT *ctx)
  * nodes, whether a node itself is visible, whether, if invisible, it has
  * depth anyway, and whether any of its later siblings are roots of visible
  * subtrees.  while it's at it, it frees the old thread display, so we can
- * skip parts of the tree in mutt_draw_tree() if we've decided here that we
- * don't care about them any more.
+ * skip parts of the tree in draw_thread_tree() if we've decided here that we
+ * don't care about them any more.  only the thread below top is visited.
  */
-static void calculate_visibility (CONTEXT *ctx, int *max_depth)
+static void calculate_visibility (CONTEXT *ctx, THREAD *top, int *max_depth)
 {
-        THREAD *tmp, *tree = ctx->tree;
+        THREAD *tmp, *tree = top;
         int hide_top_missing = option (OPTHIDETOPMISSING) && !option (OPTHIDEMISSING);
         int hide_top_limited = option (OPTHIDETOPLIMITED) && !option (OPTHIDELIMITED);
         int depth = 0;
 
 /* we walk each level backwards to make it easier to compute next_subtree_visible */
-        while (tree->next)
-                tree = tree->next;
         *max_depth = 0;
 
         FOREVER
@@ -168,14 +166,14 @@ static void calculate_visibility (CONTEXT *ctx, int *max_depth)
                         while (tree->next)
                                 tree = tree->next;
                 }
-                else if (tree->prev)
+                else if (tree != top && tree->prev)
                         tree = tree->prev;
                 else {
-                        while (tree && !tree->prev) {
+                        while (tree != top && !tree->prev) {
                                 depth--;
                                 tree = tree->parent;
                         }
-                        if (!tree)
+                        if (tree == top)
                                 break;
                         else
                                 tree = tree->prev;
@@ -184,7 +182,7 @@ static void calculate_visibility (CONTEXT *ctx, int *max_depth)
 
 /* now fix up for the OPTHIDETOP* options if necessary */
         if (hide_top_limited || hide_top_missing) {
-                tree = ctx->tree;
+                tree = top;
                 FOREVER
                 {
                         if (!tree->visible && tree->deep && tree->subtree_visible < 2
@@ -192,12 +190,12 @@ static void calculate_visibility (CONTEXT *ctx, int *max_depth)
                                 tree->deep = 0;
                         if (!tree->deep && tree->child && tree->subtree_visible)
                                 tree = tree->child;
-                        else if (tree->next)
+                        else if (tree != top && tree->next)
                                 tree = tree->next;
                         else {
-                                while (tree && !tree->next)
+                                while (tree != top && !tree->next)
                                         tree = tree->parent;
-                                if (!tree)
+                                if (tree == top)
                                         break;
                                 else
                                         tree = tree->next;
@@ -214,19 +212,22 @@ static void calculate_visibility (CONTEXT *ctx, int *max_depth)
  * ncurses should automatically use the default ASCII characters instead of
  * graphics chars on terminals which don't support them (see the man page
  * for curs_addch).
+ *
+ * The strings only depend on the thread they belong to, so they are built
+ * for one top-level thread at a time when a message of it is displayed.
  */
-void mutt_draw_tree (CONTEXT *ctx)
+static void draw_thread_tree (CONTEXT *ctx, THREAD *top)
 {
         char *pfx = NULL, *mypfx = NULL, *arrow = NULL, *myarrow = NULL, *new_tree;
         char corner = (Sort & SORT_REVERSE) ? M_TREE_ULCORNER : M_TREE_LLCORNER;
         char vtee = (Sort & SORT_REVERSE) ? M_TREE_BTEE : M_TREE_TTEE;
         int depth = 0, start_depth = 0, max_depth = 0, width = option (OPTNARROWTREE) ? 1 : 2;
-        THREAD *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = ctx->tree;
+        THREAD *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = top;
 
 /* Do the visibility calculations and free the old thread chars.
  * From now on we can simply ignore invisible subtrees
  */
-        calculate_visibility (ctx, &max_depth);
+        calculate_visibility (ctx, top, &max_depth);
         pfx = safe_malloc (width * max_depth + 2);
         arrow = safe_malloc (width * max_depth + 2);
         while (tree) {
@@ -301,7 +302,7 @@ void mutt_draw_tree (CONTEXT *ctx)
                                         nextdisp = NULL;
                                 if (tree->visible)
                                         start_depth = depth;
-                                tree = tree->next;
+                                tree = (tree == top) ? NULL : tree->next;
                                 if (!tree)
                                         break;
                         }
@@ -318,6 +319,35 @@ void mutt_draw_tree (CONTEXT *ctx)
 }
 
 
+/* Called whenever the thread tree may have changed shape or visibility:
+ * only mark the top-level threads, mutt_draw_thread() redraws them on
+ * demand.
+ */
+void mutt_draw_tree (CONTEXT *ctx)
+{
+        THREAD *tree;
+
+        for (tree = ctx->tree; tree; tree = tree->next)
+                tree->redraw_tree = 1;
+}
+
+
+/* make sure hdr->tree and hdr->display_subject are up to date */
+void mutt_draw_thread (CONTEXT *ctx, HEADER *hdr)
+{
+        THREAD *top = hdr->thread;
+
+        if (!top)
+                return;
+        while (top->parent)
+                top = top->parent;
+        if (top->redraw_tree) {
+                top->redraw_tree = 0;
+                draw_thread_tree (ctx, top);
+        }
+}
+
+
 /* since we may be trying to attach as a pseudo-thread a THREAD that
  * has no message, we have to make a list of all the subjects of its
  * most immediate existing descendants.  we also note the earliest
@@ -1021,10 +1051,63 @@ int mutt_parent_message (CONTEXT *ctx, HEADER *hdr)
 }
 
 
+/* sets num_hidden of the visible messages in every thread to what
+ * mutt_get_hidden() would return for them, with two walks per thread
+ * instead of a walk per visible message */
+static void set_hidden_counts (CONTEXT *ctx)
+{
+        THREAD *top, *thread;
+        HEADER *h;
+        int hidden, pass;
+#define CHECK_LIMIT (!ctx->pattern || h->limited)
+
+        for (top = ctx->tree; top; top = top->next) {
+                hidden = 0;
+                for (pass = 0; pass < 2; pass++) {
+                        thread = top;
+                        FOREVER
+                        {
+                                if ((h = thread->message) != NULL) {
+                                        if (pass == 0) {
+                                                if (h->virtual == -1 && CHECK_LIMIT)
+                                                        hidden++;
+                                        }
+                                        else if (h->virtual >= 0)
+                                                h->num_hidden = hidden;
+                                }
+
+                                if (thread->child)
+                                        thread = thread->child;
+                                else {
+                                        while (thread != top && !thread->next)
+                                                thread = thread->parent;
+                                        if (thread == top)
+                                                break;
+                                        thread = thread->next;
+                                }
+                        }
+
+                        if (pass == 0 && (top->child || !top->message)) {
+/* _mutt_traverse_thread() visits the first message of a thread
+ * with a fake root twice, and counts the thread's root itself */
+                                for (thread = top; !thread->message; thread = thread->child)
+                                        ;
+                                h = thread->message;
+                                if (!top->message && h->virtual == -1 && CHECK_LIMIT)
+                                        hidden++;
+                                hidden++;
+                        }
+                }
+        }
+#undef CHECK_LIMIT
+}
+
+
 void mutt_set_virtual (CONTEXT *ctx)
 {
         int i;
         HEADER *cur;
+        int threaded = (Sort & SORT_MASK) == SORT_THREADS;
 
         ctx->vcount = 0;
         ctx->vsize = 0;
@@ -1036,9 +1119,13 @@ void mutt_set_virtual (CONTEXT *ctx)
                         ctx->v2r[ctx->vcount] = i;
                         ctx->vcount++;
                         ctx->vsize += cur->content->length + cur->content->offset - cur->content->hdr_offset;
-                        cur->num_hidden = mutt_get_hidden (ctx, cur);
+                        if (!threaded)
+                                cur->num_hidden = mutt_get_hidden (ctx, cur);
                 }
         }
+
+        if (threaded)
+                set_hidden_counts (ctx);
 }
 
 